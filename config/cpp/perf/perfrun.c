@@ -0,0 +1,346 @@
+/*
+ * perfrun: time repeated runs of a program and write the results as JSON.
+ *
+ * Usage: perfrun [--runs n] [--warmup n] [--input file] [--output file]
+ *                -- program [args...]
+ *
+ * Each run has its standard input read from `file` (or /dev/null) and
+ * its standard output discarded.  Where the kernel allows it, the
+ * hardware counters of each run are read with perf_event_open; see
+ * /proc/sys/kernel/perf_event_paranoid if they are reported unavailable.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+enum { counterCount = 6 };
+
+static const struct {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} counters[counterCount] = {
+#ifdef __linux__
+    { "task_clock_ns", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+    { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "cache_references", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES },
+    { "cache_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { "branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+#else
+    { "task_clock_ns", 0, 0 },
+    { "cycles", 0, 0 },
+    { "instructions", 0, 0 },
+    { "cache_references", 0, 0 },
+    { "cache_misses", 0, 0 },
+    { "branch_misses", 0, 0 },
+#endif
+};
+
+struct Sample {
+    int64_t wall_ns;
+    int64_t user_ns;
+    int64_t sys_ns;
+    long max_rss_kb;
+    // -1 if the counter could not be read
+    int64_t counter[counterCount];
+};
+
+struct Options {
+    long runs;
+    long warmup;
+    const char *input;
+    const char *output;
+    char **argv;
+};
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int64_t timeval_ns(struct timeval tv) {
+    return (int64_t)tv.tv_sec * 1000000000 + (int64_t)tv.tv_usec * 1000;
+}
+
+#ifdef __linux__
+/* count the events of `pid` from its next exec, or return -1 */
+static int open_counter(pid_t pid, int index) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof attr);
+    attr.size = sizeof attr;
+    attr.type = counters[index].type;
+    attr.config = counters[index].config;
+    attr.disabled = 1;
+    attr.enable_on_exec = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+/* the count, scaled up if the counter was multiplexed, or -1 */
+static int64_t read_counter(int fd) {
+    uint64_t values[3];
+    if (read(fd, values, sizeof values) != (ssize_t)sizeof values || values[2] == 0) {
+        return -1;
+    }
+    if (values[2] < values[1]) {
+        return (int64_t)((double)values[0] * (double)values[1] / (double)values[2]);
+    }
+    return (int64_t)values[0];
+}
+#endif
+
+/* run the program once; returns its exit status, or -1 if it can't be run */
+static int run_once(const struct Options *opt, struct Sample *sample, int *counters_open) {
+    int go[2];
+    if (pipe(go) != 0) {
+        perror("perfrun: pipe");
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("perfrun: fork");
+        return -1;
+    }
+    if (pid == 0) {
+        // wait until the counters are attached, then become the program
+        char ready;
+        close(go[1]);
+        if (read(go[0], &ready, 1) != 1) {
+            _exit(127);
+        }
+        close(go[0]);
+        int in = open(opt->input ? opt->input : "/dev/null", O_RDONLY);
+        int out = open("/dev/null", O_WRONLY);
+        if (in < 0 || out < 0 || dup2(in, STDIN_FILENO) < 0 || dup2(out, STDOUT_FILENO) < 0) {
+            perror("perfrun: redirecting the program's input and output");
+            _exit(127);
+        }
+        execvp(opt->argv[0], opt->argv);
+        fprintf(stderr, "perfrun: cannot run %s: %s\n", opt->argv[0], strerror(errno));
+        _exit(127);
+    }
+    close(go[0]);
+    int fds[counterCount];
+    *counters_open = 0;
+    for (int i = 0; i < counterCount; ++i) {
+#ifdef __linux__
+        fds[i] = open_counter(pid, i);
+#else
+        fds[i] = -1;
+#endif
+        *counters_open += fds[i] >= 0;
+    }
+    int64_t start = now_ns();
+    if (write(go[1], "x", 1) != 1) {
+        perror("perfrun: starting the program");
+    }
+    close(go[1]);
+    int status;
+    struct rusage usage;
+    while (wait4(pid, &status, 0, &usage) < 0) {
+        if (errno != EINTR) {
+            perror("perfrun: wait");
+            return -1;
+        }
+    }
+    sample->wall_ns = now_ns() - start;
+    sample->user_ns = timeval_ns(usage.ru_utime);
+    sample->sys_ns = timeval_ns(usage.ru_stime);
+    sample->max_rss_kb = usage.ru_maxrss;
+    for (int i = 0; i < counterCount; ++i) {
+        sample->counter[i] = -1;
+#ifdef __linux__
+        if (fds[i] >= 0) {
+            sample->counter[i] = read_counter(fds[i]);
+            close(fds[i]);
+        }
+#endif
+    }
+    if (!WIFEXITED(status)) {
+        fprintf(stderr, "perfrun: %s was killed by signal %d\n", opt->argv[0], WTERMSIG(status));
+        return -1;
+    }
+    return WEXITSTATUS(status);
+}
+
+static int compare(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void write_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for ( ; *s; ++s) {
+        unsigned char ch = (unsigned char)*s;
+        if (ch == '"' || ch == '\\') {
+            fprintf(out, "\\%c", ch);
+        } else if (ch < 0x20) {
+            fprintf(out, "\\u%04x", ch);
+        } else {
+            fputc(ch, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/* write min, median, mean and max of `values`, which are sorted in place */
+static void write_stats(FILE *out, int64_t *values, long n) {
+    double sum = 0;
+    for (long i = 0; i < n; ++i) {
+        sum += (double)values[i];
+    }
+    qsort(values, (size_t)n, sizeof *values, compare);
+    int64_t median = n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+    fprintf(out, "{\"min\":%lld,\"median\":%lld,\"mean\":%.0f,\"max\":%lld}", (long long)values[0],
+            (long long)median, sum / (double)n, (long long)values[n - 1]);
+}
+
+static void write_json(FILE *out, const struct Options *opt, const struct Sample *samples, int counters_open) {
+    long n = opt->runs;
+    int64_t *values = malloc((size_t)n * sizeof *values);
+    if (!values) {
+        return;
+    }
+    fputs("{\n  \"command\": [", out);
+    for (char **arg = opt->argv; *arg; ++arg) {
+        if (arg != opt->argv) {
+            fputc(',', out);
+        }
+        write_string(out, *arg);
+    }
+    fprintf(out, "],\n  \"runs\": %ld,\n  \"warmup\": %ld,\n  \"input\": ", n, opt->warmup);
+    if (opt->input) {
+        write_string(out, opt->input);
+    } else {
+        fputs("null", out);
+    }
+#define STATS(field) \
+    for (long i = 0; i < n; ++i) { values[i] = samples[i].field; } \
+    write_stats(out, values, n);
+    fputs(",\n  \"wall_ns\": ", out);
+    STATS(wall_ns)
+    fputs(",\n  \"user_ns\": ", out);
+    STATS(user_ns)
+    fputs(",\n  \"sys_ns\": ", out);
+    STATS(sys_ns)
+    fputs(",\n  \"max_rss_kb\": ", out);
+    STATS(max_rss_kb)
+#undef STATS
+    fputs(",\n  \"counters\": {", out);
+    const char *separator = "";
+    for (int c = 0; c < counterCount; ++c) {
+        int complete = counters_open > 0;
+        for (long i = 0; i < n && complete; ++i) {
+            complete = samples[i].counter[c] >= 0;
+            values[i] = samples[i].counter[c];
+        }
+        if (complete) {
+            fprintf(out, "%s\n    \"%s\": ", separator, counters[c].name);
+            write_stats(out, values, n);
+            separator = ",";
+        }
+    }
+    fputs(*separator ? "\n  },\n" : "},\n", out);
+    fputs("  \"samples\": [", out);
+    for (long i = 0; i < n; ++i) {
+        fprintf(out, "%s\n    {\"wall_ns\":%lld,\"user_ns\":%lld,\"sys_ns\":%lld,\"max_rss_kb\":%ld",
+                i ? "," : "", (long long)samples[i].wall_ns, (long long)samples[i].user_ns,
+                (long long)samples[i].sys_ns, samples[i].max_rss_kb);
+        for (int c = 0; c < counterCount; ++c) {
+            if (samples[i].counter[c] >= 0) {
+                fprintf(out, ",\"%s\":%lld", counters[c].name, (long long)samples[i].counter[c]);
+            }
+        }
+        fputc('}', out);
+    }
+    fputs("\n  ]\n}\n", out);
+    free(values);
+}
+
+static void usage(void) {
+    fputs("Usage: perfrun [--runs n] [--warmup n] [--input file] [--output file] -- program [args...]\n", stderr);
+}
+
+int main(int argc, char *argv[]) {
+    struct Options opt = { 10, 1, NULL, "perf.json", NULL };
+    int i = 1;
+    for ( ; i < argc && strcmp(argv[i], "--") != 0; ++i) {
+        if (i + 1 == argc) {
+            usage();
+            return 2;
+        }
+        if (strcmp(argv[i], "--runs") == 0) {
+            opt.runs = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--warmup") == 0) {
+            opt.warmup = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--input") == 0) {
+            opt.input = *argv[++i] ? argv[i] : NULL;
+        } else if (strcmp(argv[i], "--output") == 0) {
+            opt.output = argv[++i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (i + 1 >= argc || opt.runs < 1 || opt.warmup < 0) {
+        usage();
+        return 2;
+    }
+    opt.argv = argv + i + 1;
+    struct Sample *samples = calloc((size_t)opt.runs, sizeof *samples);
+    if (!samples) {
+        perror("perfrun");
+        return 1;
+    }
+    int counters_open = 0;
+    struct Sample discard;
+    for (long run = -opt.warmup; run < opt.runs; ++run) {
+        int status = run_once(&opt, run < 0 ? &discard : &samples[run], &counters_open);
+        if (status != 0) {
+            if (status > 0) {
+                fprintf(stderr, "perfrun: %s exited with status %d\n", opt.argv[0], status);
+            }
+            free(samples);
+            return 1;
+        }
+    }
+    FILE *out = fopen(opt.output, "w");
+    if (!out) {
+        fprintf(stderr, "perfrun: cannot write %s: %s\n", opt.output, strerror(errno));
+        free(samples);
+        return 1;
+    }
+    write_json(out, &opt, samples, counters_open);
+    if (fclose(out) != 0) {
+        fprintf(stderr, "perfrun: cannot write %s: %s\n", opt.output, strerror(errno));
+        free(samples);
+        return 1;
+    }
+    int64_t best = samples[0].wall_ns;
+    for (long run = 1; run < opt.runs; ++run) {
+        best = samples[run].wall_ns < best ? samples[run].wall_ns : best;
+    }
+    printf("%s: %ld runs, best %.3f ms, hardware counters %s; wrote %s\n", opt.argv[0], opt.runs,
+            (double)best / 1e6, counters_open == counterCount ? "read" : counters_open ? "partly read" : "unavailable", opt.output);
+    free(samples);
+    return 0;
+}
@@ -2,28 +2,26 @@
 #include "AutoProject.h"
 #include <unordered_set>
 #include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <atomic>
+#include <exception>
 #include <iostream>
 #include <iterator>
+#include <mutex>
 #include <regex>
 #include <sstream>
+#include <thread>
+#include <type_traits>
 #include <vector>
 #include <string_view>
+#include "ConfigSnapshot.h"
+#include "ShardStatus.h"
+#include "SpscQueue.h"
 #include "trim.h"
 
 using namespace std::literals;
 
-// local definitions
-struct Rule {
-    const std::regex re;
-    const std::string cmake;
-    const std::string libraries;
-    static const std::regex newline;
-    Rule(std::string reg, std::string result, std::string libraries) : re{reg}, 
-        cmake{std::regex_replace(result, newline, "\n")},
-        libraries{libraries} {
-    }
-};
-
 // helper functions
 static bool isNonEmptyIndented(const std::string& line);
 static bool isIndentedOrEmpty(const std::string& line);
@@ -32,40 +30,605 @@ static bool isDelimited(const std::string& line);
 static bool isSourceExtension(const std::string_view ext);
 static bool isSourceFilename(std::string& line);
 static std::string &replaceLeadingTabs(std::string& line);
-static void emit(std::ostream& out, const std::string& line);
-static std::vector<Rule> loadrules(const fs::path& rulesfile);
+static std::string_view unindent(const std::string& line);
+static std::vector<std::string_view> parseTags(std::string_view line);
 
 // local constants
 static const std::string mdextension{".md"};
 static constexpr unsigned indentLevel{4};
 static constexpr unsigned delimLength{3};
-const std::regex Rule::newline{R"(\\n)"};
+static constexpr std::string_view tagsHeader{"### tags: ["};
+/*
+ * The tags which identify each language, in order of precedence.  A
+ * prefix tag also matches the versioned tags such as "c++17".
+ */
+static constexpr struct {
+    std::string_view tag;
+    std::string_view lang;
+    bool prefix;
+} languageTags[]{
+    { "c++", "c++", true },
+    { "c", "c", false },
+    { "assembly", "asm", false },
+};
+
+/*
+ * The flags match what the shipped templates ask of CMake, so that a 
+ * project which passes --check should also build.
+ */
+static const struct {
+    std::string_view name;
+    std::string_view compiler;
+    std::string_view compileflags;
+    std::string_view syntaxcheckflags;
+    std::string_view linker;
+    std::string_view linkflags;
+    // the templates' project() enables C and C++; nasm can't be cached
+    std::string_view launcherlanguages;
+    SourceDialect dialect;
+} defaultToolchains[]{
+    { "c++", "c++", "-std=c++20", "-fsyntax-only", "c++", "", "C CXX", SourceDialect::c },
+    { "c", "cc", "-std=c11", "-fsyntax-only", "cc", "", "C CXX", SourceDialect::c },
+    { "asm", "nasm", "-f elf64", "-o /dev/null", "ld", "", "", SourceDialect::nasm },
+};
+
+std::map<std::string, LangConfig> builtinLanguageSettings() {
+    std::map<std::string, LangConfig> lang;
+    for (const auto& builtin : embeddedLanguages()) {
+        auto& config{lang[std::string{builtin.name}]};
+        config.builtin = &builtin;
+        config.clonedir = builtin.clonedir;
+        config.clonefiles = builtin.clonefiles;
+        config.harnessdir = builtin.harnessdir;
+        config.harnessfiles = builtin.harnessfiles;
+    }
+    for (const auto& toolchain : defaultToolchains) {
+        auto& config{lang[std::string{toolchain.name}]};
+        config.compiler = toolchain.compiler;
+        config.compileflags = toolchain.compileflags;
+        config.syntaxcheckflags = toolchain.syntaxcheckflags;
+        config.linker = toolchain.linker;
+        config.linkflags = toolchain.linkflags;
+        config.launcherlanguages = toolchain.launcherlanguages;
+        config.dialect = toolchain.dialect;
+    }
+    return lang;
+}
+
+/*
+ * The profiles every configuration has.  A configuration file's sections
+ * for the same profile are applied afterwards, so they can change these.
+ */
+static constexpr std::string_view builtinProfiles{
+    "[c++.lean]\nCloneDir=none\n"
+    "[c.lean]\nCloneDir=none\n"
+};
+
+// apply the settings of one section of `cfg` to `config`
+static void applySettings(const ConfigFile &cfg, const std::string& section, const std::string& configfiledir, 
+        LangConfig& config) 
+{
+    // a directory setting of "none" means no directory
+    auto directory = [&](const std::string& key) {
+        auto dir{cfg.get_value(section, key)};
+        return dir == "none" ? fs::path{} : fs::path{dir};
+    };
+    // a profile's section, e.g. "c++.lean", only changes what it names
+    const bool profile{section.find('.') != std::string::npos};
+    if (cfg.has_value(section, "Subdir") || (!config.builtin && !profile)) {
+        config.configdir = configfiledir + "/" + cfg.get_value(section, "Subdir");
+        config.clonefiles = {};
+        config.harnessfiles = {};
+    }
+    if (cfg.has_value(section, "RulesFileName")) {
+        config.rulesfilename = config.configdir / cfg.get_value(section, "RulesFileName");
+    }
+    if (cfg.has_value(section, "TopLevelCMakeFileName")) {
+        config.toplevelcmakefilename = config.configdir / cfg.get_value(section, "TopLevelCMakeFileName");
+    }
+    if (cfg.has_value(section, "SrcLevelCMakeFileName")) {
+        config.srclevelcmakefilename = config.configdir / cfg.get_value(section, "SrcLevelCMakeFileName");
+    }
+    if (cfg.has_value(section, "CloneDir")) {
+        config.clonedir = directory("CloneDir");
+        config.clonefiles = {};
+    }
+    if (cfg.has_value(section, "PerfHarnessDir")) {
+        config.harnessdir = directory("PerfHarnessDir");
+        config.harnessfiles = {};
+    }
+    if (cfg.has_value(section, "Compiler")) {
+        config.compiler = cfg.get_value(section, "Compiler");
+    }
+    if (cfg.has_value(section, "CompileFlags")) {
+        config.compileflags = cfg.get_value(section, "CompileFlags");
+    }
+    if (cfg.has_value(section, "SyntaxCheckFlags")) {
+        config.syntaxcheckflags = cfg.get_value(section, "SyntaxCheckFlags");
+    }
+    if (cfg.has_value(section, "Linker")) {
+        config.linker = cfg.get_value(section, "Linker");
+    }
+    if (cfg.has_value(section, "LinkFlags")) {
+        config.linkflags = cfg.get_value(section, "LinkFlags");
+    }
+}
+
+std::map<std::string, LangConfig> fetchLanguageSettings(const ConfigFile &cfg, const std::string& profile) {
+    std::map<std::string, LangConfig> lang{builtinLanguageSettings()};
+    auto configfiledir = cfg.get_value("General", "ConfigFileDir");
+    for (const auto& section : cfg) {
+        if (section.first != "general" && section.first.find('.') == std::string::npos) {
+            applySettings(cfg, section.first, configfiledir, lang[section.first]);
+        }
+    }
+    if (!profile.empty() && profile != "full") {
+        std::istringstream builtinText{std::string{builtinProfiles}};
+        const ConfigFile builtin{builtinText};
+        const auto suffix{"." + profile};
+        bool found{false};
+        for (const auto *source : {&builtin, &cfg}) {
+            for (const auto& section : *source) {
+                const auto& name{section.first};
+                if (name.ends_with(suffix)) {
+                    found = true;
+                    auto it{lang.find(name.substr(0, name.size() - suffix.size()))};
+                    if (it != lang.end()) {
+                        applySettings(*source, name, configfiledir, it->second);
+                    }
+                }
+            }
+        }
+        if (!found) {
+            throw std::runtime_error("unknown profile \"" + profile + "\"");
+        }
+    }
+    const auto cache{std::make_shared<const CompilerCache>(findCompilerCache(
+            cfg.get_value("General", "CompilerLauncher"), cfg.get_value("General", "CompilerCacheDir")))};
+    for (auto& [name, config] : lang) {
+        config.cache = cache;
+    }
+    return lang;
+}
+
+// read an unsigned setting of the General section into `value`, if it is there
+template <typename T>
+static void fetchUnsigned(const ConfigFile &cfg, const std::string& key, T& value) {
+    if (cfg.has_value("General", key)) {
+        const auto text{cfg.get_value("General", key)};
+        std::size_t used{0};
+        try {
+            value = static_cast<T>(std::stoull(text, &used));
+        }
+        catch (const std::logic_error&) {
+            used = 0;
+        }
+        if (used != text.size() || text.starts_with('-')) {
+            throw std::runtime_error("bad value \"" + text + "\" for " + key);
+        }
+    }
+}
+
+ExtractionLimits fetchExtractionLimits(const ConfigFile &cfg) {
+    ExtractionLimits limits;
+    fetchUnsigned(cfg, "MaxInputBytes", limits.maxInputBytes);
+    fetchUnsigned(cfg, "MaxLineLength", limits.maxLineLength);
+    fetchUnsigned(cfg, "MaxOutputFiles", limits.maxOutputFiles);
+    fetchUnsigned(cfg, "MaxOutputBytes", limits.maxOutputBytes);
+    std::uintmax_t timeout{0};
+    fetchUnsigned(cfg, "ProjectTimeoutMs", timeout);
+    limits.timeout = std::chrono::milliseconds{timeout};
+    return limits;
+}
+
+OutputLayout fetchOutputLayout(const ConfigFile &cfg) {
+    OutputLayout layout;
+    layout.root = cfg.get_value("General", "OutputRoot");
+    std::uintmax_t levels{0};
+    fetchUnsigned(cfg, "OutputFanout", levels);
+    if (levels > OutputLayout::maxLevels) {
+        throw std::runtime_error("OutputFanout of " + std::to_string(levels) + " is more than " 
+                + std::to_string(OutputLayout::maxLevels));
+    }
+    layout.levels = static_cast<unsigned>(levels);
+    return layout;
+}
+
+fs::path OutputLayout::directory(const fs::path& mdfile) const {
+    static constexpr char hex[]{"0123456789abcdef"};
+    const auto projname{mdfile.stem()};
+    fs::path dir{root.empty() ? mdfile.parent_path() : root};
+    const auto hash{stableHash(projname.string())};
+    for (unsigned level{0}; level < levels; ++level) {
+        // the most significant byte first
+        const auto byte{static_cast<unsigned>(hash >> (56 - 8 * level)) & 0xffu};
+        dir /= std::string{hex[byte >> 4], hex[byte & 0xf]};
+    }
+    return dir / projname;
+}
+
+LimitExceeded::LimitExceeded(std::string limit, std::uintmax_t allowed, std::uintmax_t actual, std::size_t line) :
+    std::runtime_error{limit + " of " + std::to_string(allowed) + " exceeded: " + std::to_string(actual) 
+        + (line ? " at line " + std::to_string(line) : "")},
+    name{std::move(limit)},
+    limitValue{allowed},
+    actualValue{actual},
+    lineNumber{line}
+{}
+
+void loadLanguage(LangConfig& config) {
+    // projects extracted on different threads may share the settings
+    static std::mutex loading;
+    std::lock_guard<std::mutex> lock{loading};
+    if (!config.rules) {
+        if (config.rulesfilename.empty() && config.builtin) {
+            config.rules = std::make_shared<const RuleSet>(compileRules(config.builtin->rules, "(built-in)"));
+        } else {
+            config.rules = std::make_shared<const RuleSet>(loadrules(config.rulesfilename));
+        }
+    }
+    if (!config.toplevel) {
+        if (config.toplevelcmakefilename.empty() && config.builtin) {
+            config.toplevel = std::make_shared<const Template>(config.builtin->toplevel);
+        } else {
+            config.toplevel = Template::load(config.toplevelcmakefilename);
+        }
+    }
+    if (!config.srclevel) {
+        if (config.srclevelcmakefilename.empty() && config.builtin) {
+            config.srclevel = std::make_shared<const Template>(config.builtin->srclevel);
+        } else {
+            config.srclevel = Template::load(config.srclevelcmakefilename);
+        }
+    }
+}
 
-// local variables
-static std::vector<Rule> rules;
+void preloadLanguages(std::map<std::string, LangConfig>& lang) {
+    for (auto& [name, config] : lang) {
+        if (!config.rules && !config.rulesfilename.empty()) {
+            config.rules = std::make_shared<const RuleSet>(readRules(config.rulesfilename));
+        }
+        loadLanguage(config);
+    }
+}
 
 // AutoProject interface functions
-void AutoProject::open(fs::path mdFilename, std::map<std::string, LangConfig> lang) {
-    AutoProject ap(mdFilename, lang);
+void AutoProject::open(fs::path mdFilename, std::map<std::string, LangConfig>& lang, std::pmr::memory_resource *arena) {
+    AutoProject ap(mdFilename, lang, arena);
     std::swap(ap, *this);
 }
 
-AutoProject::AutoProject(fs::path mdFilename, std::map<std::string, LangConfig> lang) :
+AutoProject::AutoProject(fs::path mdFilename, std::map<std::string, LangConfig>& lang, std::pmr::memory_resource *arena) :
+    AutoProject(mdFilename, &lang, arena, std::nullopt)
+{}
+
+AutoProject::AutoProject(fs::path mdFilename, std::string contents, std::map<std::string, LangConfig>& lang, 
+        std::pmr::memory_resource *arena) :
+    AutoProject(mdFilename, &lang, arena, std::move(contents))
+{}
+
+AutoProject::AutoProject(fs::path mdFilename, std::shared_ptr<const ConfigSnapshot> snapshot, 
+        std::pmr::memory_resource *arena) :
+    AutoProject(mdFilename, nullptr, arena, std::nullopt)
+{
+    this->snapshot = std::move(snapshot);
+    setLimits(this->snapshot->limits);
+    setOutputLayout(this->snapshot->layout);
+}
+
+AutoProject::AutoProject(fs::path mdFilename, std::map<std::string, LangConfig> *lang, std::pmr::memory_resource *arena,
+        std::optional<std::string> contents) :
     mdfile{mdFilename},
     outdir{mdFilename.replace_extension("")},
-    projname{mdfile.stem().string()},
-    srcdir{outdir.string() + "/src"},
-    in{mdfile},
-    lang{lang}
+    projname{mdfile.stem().string(), arena},
+    target{cmakeTargetName(projname), arena},
+    srcdir{outdir.string() + "/src", arena},
+    mdtext{std::move(contents)},
+    lang{lang},
+    thislang{arena},
+    srcnames{arena},
+    firedRules{arena},
+    fired(arena)
 {
     if (mdfile.extension() != mdextension) {
         throw FileExtensionException("Input file must have " + mdextension + " extension");
     }
-    if (!in) {
+    if (mdtext) {
+        in = std::make_unique<std::istringstream>(*mdtext);
+    } else {
+        in = std::make_unique<std::ifstream>(mdfile);
+    }
+    if (!*in) {
         throw std::runtime_error("Cannot open input file "s + mdfile.string());
     }
 }
 
+void AutoProject::setOutputLayout(const OutputLayout& layout) {
+    outdir = layout.directory(mdfile);
+    srcdir.assign(outdir.string() + "/src");
+}
+
+/*
+ * Receives the source lines found by `scan`, checking each against the
+ * rules and writing it to its file, all on the calling thread.
+ */
+struct AutoProject::DirectSink {
+    AutoProject& ap;
+    std::ofstream srcfile{};
+
+    void makeTree(bool overwrite) {
+        ap.makeTree(overwrite);
+    }
+    bool open(const fs::path& filename) {
+        srcfile.open(filename);
+        ap.startFile();
+        return static_cast<bool>(srcfile);
+    }
+    void code(const std::string& line, bool indented) {
+        ap.checkRules(line);
+        srcfile << (indented ? unindent(line) : line) << '\n';
+    }
+    void close() {
+        srcfile.close();
+    }
+};
+
+/*
+ * Receives the source lines found by `scan` and passes them, in chunks,
+ * through two more threads: one which checks them against the rules and
+ * one which writes them out.  Files are still opened by the scanning
+ * thread so that it knows immediately whether the open succeeded, which
+ * keeps the generated files identical to those of `DirectSink`.
+ */
+struct AutoProject::PipelinedSink {
+    struct Chunk {
+        // destination of `text`; shared so the writer can close it once done
+        std::shared_ptr<std::ofstream> file;
+        // original lines, to be checked against `rules`
+        std::vector<std::string> lines;
+        const RuleSet *rules{nullptr};
+        // true if `lines` begin a new file, in `dialect`
+        bool start{false};
+        SourceDialect dialect{SourceDialect::c};
+        // the lines as they are to be written to `file`
+        std::string text;
+        bool close{false};
+        bool last{false};
+    };
+    static constexpr std::size_t chunkLines{256};
+    static constexpr std::size_t queueDepth{16};
+
+    AutoProject& ap;
+    SpscQueue<Chunk, queueDepth> toMatcher;
+    SpscQueue<Chunk, queueDepth> toWriter;
+    Chunk pending;
+    std::shared_ptr<std::ofstream> srcfile;
+    std::size_t sent{0};
+    std::atomic<std::size_t> written{0};
+    std::exception_ptr matchError;
+    std::exception_ptr writeError;
+    std::thread matcher;
+    std::thread writer;
+    bool finished{false};
+
+    explicit PipelinedSink(AutoProject& ap) : 
+        ap{ap}, 
+        matcher{&PipelinedSink::match, this}, 
+        writer{&PipelinedSink::write, this} 
+    {}
+    PipelinedSink(const PipelinedSink&) = delete;
+    PipelinedSink& operator=(const PipelinedSink&) = delete;
+    ~PipelinedSink() {
+        if (!finished) {
+            send(true);
+            matcher.join();
+            writer.join();
+        }
+    }
+
+    void makeTree(bool overwrite) {
+        ap.makeTree(overwrite);
+    }
+    bool open(const fs::path& filename) {
+        send();
+        // a file opened a second time must not be truncated while the 
+        // writer may still be appending to the first one
+        if (ap.hasSource(filename)) {
+            for (auto n{written.load()}; n != sent; n = written.load()) {
+                written.wait(n);
+            }
+        }
+        auto file{std::make_shared<std::ofstream>(filename)};
+        if (!*file) {
+            return false;
+        }
+        srcfile = file;
+        pending.start = true;
+        return true;
+    }
+    void code(const std::string& line, bool indented) {
+        pending.lines.push_back(line);
+        pending.text.append(indented ? unindent(line) : line).push_back('\n');
+        if (pending.lines.size() == chunkLines) {
+            send();
+        }
+    }
+    void close() {
+        pending.close = true;
+        send();
+        srcfile.reset();
+    }
+    /// wait for the other stages to finish, rethrowing anything they threw
+    void finish() {
+        finished = true;
+        send(true);
+        matcher.join();
+        writer.join();
+        for (auto error : {matchError, writeError}) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    void send(bool last = false) {
+        if (pending.lines.empty() && !pending.close && !last) {
+            return;
+        }
+        pending.file = srcfile;
+        pending.rules = ap.config ? ap.config->rules.get() : nullptr;
+        pending.dialect = ap.config ? ap.config->dialect : SourceDialect::c;
+        pending.last = last;
+        toMatcher.push(std::move(pending));
+        ++sent;
+        pending = Chunk{};
+    }
+    // runs on its own thread
+    void match() {
+        SourceTokenizer tokenizer;
+        for (bool last{false}; !last; ) {
+            Chunk chunk{toMatcher.pop()};
+            last = chunk.last;
+            if (chunk.start) {
+                tokenizer.reset(chunk.dialect);
+            }
+            if (!matchError && chunk.rules) {
+                try {
+                    for (const auto& line : chunk.lines) {
+                        ap.checkRules(tokenizer.next(line), *chunk.rules);
+                    }
+                }
+                catch (...) {
+                    matchError = std::current_exception();
+                }
+            }
+            toWriter.push(std::move(chunk));
+        }
+    }
+    // runs on its own thread
+    void write() {
+        for (bool last{false}; !last; ) {
+            Chunk chunk{toWriter.pop()};
+            last = chunk.last;
+            if (!writeError && chunk.file) {
+                try {
+                    *chunk.file << chunk.text;
+                    if (chunk.close) {
+                        chunk.file->close();
+                    }
+                }
+                catch (...) {
+                    writeError = std::current_exception();
+                }
+            }
+            written.store(written.load() + 1);
+            written.notify_one();
+        }
+    }
+};
+
+/*
+ * Receives the source lines found by `scan` and only passes them on.
+ */
+struct AutoProject::CodeSink {
+    AutoProject& ap;
+    const std::function<void(const SourceLine&, const RuleSet *)>& visit;
+
+    void makeTree(bool) {}
+    bool open(const fs::path&) {
+        ap.startFile();
+        return true;
+    }
+    void code(const std::string& line, bool) {
+        visit(ap.tokenizer.next(line), ap.config ? ap.config->rules.get() : nullptr);
+    }
+    void close() {}
+};
+
+void AutoProject::scanCode(const std::function<void(const SourceLine& line, const RuleSet *rules)>& visit) {
+    CodeSink sink{*this, visit};
+    scan(false, sink);
+    in.reset();
+}
+
+/*
+ * Receives the source lines found by `scan`, checking each against the
+ * rules and adding it to its file in the batch.
+ */
+struct AutoProject::BatchSink {
+    AutoProject& ap;
+    OutputBatch& batch;
+    std::string *srcfile{nullptr};
+
+    void makeTree(bool overwrite) {
+        ap.makeTree(overwrite, &batch);
+    }
+    bool open(const fs::path& filename) {
+        // opening the file directly would fail if its directory was missing
+        if (filename.parent_path() != fs::path{ap.srcdir} && !fs::is_directory(filename.parent_path())) {
+            return false;
+        }
+        srcfile = &batch.file(filename);
+        ap.startFile();
+        return true;
+    }
+    void code(const std::string& line, bool indented) {
+        ap.checkRules(line);
+        srcfile->append(indented ? unindent(line) : line).push_back('\n');
+    }
+    void close() {
+        srcfile = nullptr;
+    }
+};
+
+bool AutoProject::createProject(bool overwrite, OutputBatch& batch) {
+    BatchSink sink{*this, batch};
+    scan(overwrite, sink);
+    in.reset();
+    if (!srcnames.empty()) {
+        batch.file(fs::path{srcdir} / "CMakeLists.txt") = srcLevel();
+        copyCloneDir(batch);
+        batch.file(outdir / "CMakeLists.txt") = topLevel();
+        auto& copy{batch.file(fs::path{srcdir} / mdfile.filename())};
+        if (mdtext) {
+            copy = *mdtext;
+        } else {
+            std::ifstream md{mdfile, std::ios::binary};
+            std::stringstream contents;
+            contents << md.rdbuf();
+            copy = std::move(contents).str();
+        }
+    }
+    return !srcnames.empty();
+}
+
+bool AutoProject::createProject(bool overwrite, bool pipelined) {
+    if (pipelined) {
+        PipelinedSink sink{*this};
+        scan(overwrite, sink);
+        sink.finish();
+    } else {
+        DirectSink sink{*this};
+        scan(overwrite, sink);
+    }
+    in.reset();
+    if (!srcnames.empty()) {
+        auto text{srcLevel()};
+        std::ofstream{fs::path{srcdir} / "CMakeLists.txt"} << text;
+        copyCloneDir(overwrite);
+        text = topLevel();
+        std::ofstream{outdir / "CMakeLists.txt"} << text;
+        // copy md file to projname/src
+        if (mdtext) {
+            std::ofstream{fs::path{srcdir} / mdfile.filename(), std::ios::binary} << *mdtext;
+        } else {
+            auto options = overwrite ? fs::copy_options::overwrite_existing : fs::copy_options::none;
+            fs::copy_file(mdfile, fs::path{srcdir} / mdfile.filename(), options);
+        }
+    }
+    return !srcnames.empty();
+}
+
 /*
  * As of January 2019, according to this post:
  * https://meta.stackexchange.com/questions/125148/implement-style-fenced-markdown-code-blocks
@@ -74,36 +637,46 @@ AutoProject::AutoProject(fs::path mdFilename, std::map<std::string, LangConfig>
  * indented flavor.  As a result, this code is modified to also accept
  * that syntax as of April 2019.
  */
-bool AutoProject::createProject(bool overwrite) {
+template <typename Sink>
+void AutoProject::scan(bool overwrite, Sink& sink) {
     std::string prevline;
     bool inIndentedFile{false};
     bool inDelimitedFile{false};
     bool firstFile{true};
-    std::ofstream srcfile;
     fs::path srcfilename;
+    const auto start{std::chrono::steady_clock::now()};
+    if (limits.maxInputBytes) {
+        if (auto size{mdtext ? mdtext->size() : fs::file_size(mdfile)}; size > limits.maxInputBytes) {
+            throw LimitExceeded("MaxInputBytes", limits.maxInputBytes, size);
+        }
+    }
+    auto code = [&](const std::string& line, bool indented) {
+        addOutput((indented ? unindent(line) : std::string_view{line}).size() + 1);
+        sink.code(line, indented);
+    };
     // TODO: this might be much cleaner with a state machine
-    for (std::string line; getline(in, line); ) {
+    for (std::string line; in && getline(*in, line); ) {
+        ++lineNumber;
+        checkLimits(line, start);
         replaceLeadingTabs(line);
         // scan through looking for lines indented with indentLevel spaces
         if (inIndentedFile) {
             // stop writing if non-indented line or EOF
             if (!isIndentedOrEmpty(line)) {
                 std::swap(prevline, line);
-                srcfile.close();
+                sink.close();
                 inIndentedFile = false;
             } else {
-                checkRules(line);
-                emit(srcfile, line);
+                code(line, true);
             }
         } else if (inDelimitedFile) {
             // stop writing if delimited line
             if (isDelimited(line)) {
                 std::swap(prevline, line);
-                srcfile.close();
+                sink.close();
                 inDelimitedFile = false;
             } else {
-                checkRules(line);
-                srcfile << line << '\n';
+                code(line, false);
             }
         } else {
             if (isDelimited(line)) {
@@ -120,31 +693,28 @@ bool AutoProject::createProject(bool overwrite) {
                     } 
                 }
                 if (firstFile) {
-                    makeTree(overwrite);
+                    sink.makeTree(overwrite);
                     firstFile = false;
                 }
-                srcfile.open(srcfilename);
-                if (srcfile) {
-                    srcnames.emplace(srcfilename.filename());
+                if (sink.open(srcfilename)) {
+                    addSource(srcfilename);
                     inDelimitedFile = true;
                 }
             } else if (isNonEmptyIndented(line)) {
                 // if previous line was filename, open that file and start writing
                 if (isSourceFilename(prevline)) {
                     if (firstFile) {
-                        makeTree(overwrite);
+                        sink.makeTree(overwrite);
                         firstFile = false;
                     }
                     srcfilename = fs::path(srcdir) / prevline;
-                    srcfile.open(srcfilename);
-                    if (srcfile) {
-                        checkRules(line);
-                        emit(srcfile, line);
-                        srcnames.emplace(srcfilename.filename());
+                    if (sink.open(srcfilename)) {
+                        code(line, true);
+                        addSource(srcfilename);
                         inIndentedFile = true;
                     }
                 } else if (firstFile && !line.empty()) {  // un-named source file
-                    makeTree(overwrite);
+                    sink.makeTree(overwrite);
                     firstFile = false;
                     if (thislang == "c") {
                         srcfilename = fs::path(srcdir) / "main.c";
@@ -153,11 +723,9 @@ bool AutoProject::createProject(bool overwrite) {
                     } else if (thislang == "asm") {
                         srcfilename = fs::path(srcdir) / "main.asm";
                     }
-                    srcfile.open(srcfilename);
-                    if (srcfile) {
-                        checkRules(line);
-                        emit(srcfile, line);
-                        srcnames.emplace(srcfilename.filename());
+                    if (sink.open(srcfilename)) {
+                        code(line, true);
+                        addSource(srcfilename);
                         inIndentedFile = true;
                     }
                 }
@@ -169,95 +737,248 @@ bool AutoProject::createProject(bool overwrite) {
             }
         }
     }
-    in.close();
-    if (!srcnames.empty()) {
-        writeSrcLevel();
-        copyCloneDir(overwrite);
-        writeTopLevel();
-        // copy md file to projname/src
-        auto options = overwrite ? fs::copy_options::overwrite_existing : fs::copy_options::none;
-        fs::copy_file(mdfile, srcdir + "/" + projname + mdextension, options);
-    }
-    return !srcnames.empty();
 }
 
-void AutoProject::makeTree(bool overwrite) {
+void AutoProject::makeTree(bool overwrite, OutputBatch *batch) {
     fs::path builddir{outdir.string() + "/build"};
-    if (overwrite) {
+    if (!overwrite && fs::exists(outdir)) {
+        throw std::runtime_error(outdir.string() + " already exists: will not overwrite.");
+    }
+    if (batch) {
+        batch->directory(srcdir);
+        batch->directory(builddir);
+    } else if (overwrite) {
         fs::create_directories(srcdir);
         fs::create_directories(builddir);
     } else {
-        if (fs::exists(outdir)) {
-            throw std::runtime_error(outdir.string() + " already exists: will not overwrite.");
-        }
         if (!fs::create_directories(srcdir)) {
-            throw std::runtime_error("Cannot create directory "s + srcdir);
+            throw std::runtime_error("Cannot create directory "s + srcdir.c_str());
         }
         fs::create_directories(builddir);
     }
 }
 
-void AutoProject::writeSrcLevel() const {
-    static const std::regex projname_regex{"[{]projname[}]"};
-    static const std::regex extras_regex{"[{]extras[}]"};
-    static const std::regex srcnames_regex{"[{]srcnames[}]"};
-    static const std::regex libraries_regex{"[{]libraries[}]"};
-    std::ifstream in{srclevelfilename};
-    if (!in) {
-        std::cerr << "Error: cannot open source level filename \"" << srclevelfilename << "\"\n";
-        exit(1);
+std::string AutoProject::srcLevel() const {
+    if (!config || !config->srclevel) {
+        throw std::runtime_error("No source level CMake template for language \""s + thislang.c_str() + "\"");
+    }
+    // several rules may share the same extras or libraries, so each is written once
+    std::pmr::vector<std::string_view> seen{srcnames.get_allocator()};
+    auto once = [&seen](std::string_view item) {
+        if (std::find(seen.begin(), seen.end(), item) != seen.end()) {
+            return false;
+        }
+        seen.push_back(item);
+        return true;
+    };
+    std::pmr::string extras{srcnames.get_allocator()};
+    for (auto index : firedRules) {
+        const auto& cmake{(*config->rules)[index].cmake};
+        if (once(cmake)) {
+            extras.append(cmake).push_back('\n');
+        }
     }
-    std::stringstream extras;
-    for (const auto &rule : extraRules) {
-        extras << rule << '\n';
+    seen.clear();
+    std::pmr::string libs{srcnames.get_allocator()};
+    for (auto index : firedRules) {
+        const auto& lib{(*config->rules)[index].libraries};
+        if (once(lib)) {
+            libs.append(" ").append(lib);
+        }
     }
     std::stringstream sources;
     for (const auto& fn : srcnames) {
-        sources << ' ' << fn;
+        sources << ' ' << std::quoted(fn);
     }
-    std::stringstream libs;
-    for (const auto &lib : libraries) {
-        libs << ' ' << lib;
+    // CMakeLists.txt with filenames for projname/src
+    std::ostringstream srccmake;
+    config->srclevel->render(srccmake, {
+        { "projname", target },
+        { "srcnames", sources.view() },
+        { "extras", extras },
+        { "libraries", libs },
+    });
+    return std::move(srccmake).str();
+}
+
+void AutoProject::copyCloneDir(OutputBatch& batch) const {
+    if (!config) {
+        return;
     }
-    // write CMakeLists.txt with filenames to projname/src
-    std::ofstream srccmake(srcdir + "/CMakeLists.txt");
-    std::string line;
-    while (std::getline(in, line)) {
-        line = std::regex_replace(line, projname_regex, projname);
-        line = std::regex_replace(line, srcnames_regex, sources.str());
-        line = std::regex_replace(line, extras_regex, extras.str());
-        line = std::regex_replace(line, libraries_regex, libs.str());
-        srccmake << line << '\n';
+    copyDir(config->clonedir, config->clonefiles, batch);
+    if (perfHarness) {
+        copyDir(config->harnessdir, config->harnessfiles, batch);
     }
 }
 
 void AutoProject::copyCloneDir(bool overwrite) const {
-    if (!clonedir.empty()) {
+    if (!config) {
+        return;
+    }
+    copyDir(config->clonedir, config->clonefiles, overwrite);
+    if (perfHarness) {
+        copyDir(config->harnessdir, config->harnessfiles, overwrite);
+    }
+}
+
+void AutoProject::copyDir(const fs::path& dir, std::span<const EmbeddedFile> files, OutputBatch& batch) const {
+    if (!files.empty()) {
+        for (const auto& file : files) {
+            fs::path target{outdir / dir / file.path};
+            batch.directory(target.parent_path());
+            batch.file(target) = file.contents;
+        }
+    } else if (!dir.empty()) {
+        const auto source{config->configdir / dir};
+        batch.directory(outdir / dir);
+        for (const auto& entry : fs::recursive_directory_iterator(source)) {
+            fs::path target{outdir / dir / fs::relative(entry.path(), source)};
+            if (entry.is_directory()) {
+                batch.directory(target);
+            } else {
+                std::ifstream in{entry.path(), std::ios::binary};
+                std::stringstream contents;
+                contents << in.rdbuf();
+                batch.file(target) = std::move(contents).str();
+            }
+        }
+    }
+}
+
+void AutoProject::copyDir(const fs::path& dir, std::span<const EmbeddedFile> files, bool overwrite) const {
+    if (!files.empty()) {
+        for (const auto& file : files) {
+            fs::path target{outdir / dir / file.path};
+            fs::create_directories(target.parent_path());
+            std::ofstream out{target, std::ios::binary};
+            out.write(file.contents.data(), static_cast<std::streamsize>(file.contents.size()));
+        }
+    } else if (!dir.empty()) {
         auto options = overwrite ? fs::copy_options::overwrite_existing|fs::copy_options::recursive : fs::copy_options::recursive;
-        fs::copy(configdir / clonedir, outdir.string() / clonedir, options);
+        fs::copy(config->configdir / dir, outdir / dir, options);
+    }
+}
+
+std::string AutoProject::topLevel() const {
+    if (!config || !config->toplevel) {
+        throw std::runtime_error("No top level CMake template for language \""s + thislang.c_str() + "\"");
+    }
+    // the optional lines are only given values when wanted, so that
+    // their lines are left out otherwise
+    std::vector<Template::Value> values{{ "projname", target }};
+    std::string launcher;
+    if (config->cache && *config->cache) {
+        launcher = config->cache->cmake(config->launcherlanguages);
+    }
+    if (!launcher.empty()) {
+        values.emplace_back("launcher", launcher);
+    }
+    std::string harness;
+    if (perfHarness && !config->harnessdir.empty()) {
+        harness = "add_subdirectory(" + config->harnessdir.generic_string() + ")";
+        values.emplace_back("harness", harness);
     }
+    std::string clonedir;
+    if (!config->clonedir.empty()) {
+        clonedir = "add_subdirectory(" + config->clonedir.generic_string() + ")";
+        values.emplace_back("clonedir", clonedir);
+    }
+    std::ostringstream topcmake;
+    config->toplevel->render(topcmake, values);
+    return std::move(topcmake).str();
 }
 
-void AutoProject::writeTopLevel() const {
-    static const std::regex projname_regex{"[{]projname[}]"};
-    std::ifstream in{toplevelfilename};
-    if (!in) {
-        std::cerr << "Error: cannot open top level filename \"" << toplevelfilename << "\"\n";
-        exit(1);
+BuildInfo AutoProject::buildInfo() const {
+    BuildInfo info;
+    info.projname = projname;
+    info.target = target;
+    info.outdir = outdir;
+    info.srcdir = std::string_view{srcdir};
+    info.lang = thislang;
+    for (const auto& name : srcnames) {
+        info.sources.push_back(fs::path{srcdir} / name);
+    }
+    if (!config) {
+        return info;
     }
-    std::ofstream topcmake{outdir.string() + "/CMakeLists.txt"};
-    std::string line;
-    while (std::getline(in, line)) {
-        topcmake << std::regex_replace(line, projname_regex, projname) << '\n';
+    info.compiler = config->compiler;
+    if (config->cache && !config->launcherlanguages.empty()) {
+        info.launcher = config->cache->command();
     }
+    info.flags = config->compileflags;
+    info.syntaxcheckflags = config->syntaxcheckflags;
+    info.linker = config->linker;
+    info.linkflags = config->linkflags;
+    // append flags unless they are already there
+    auto add = [](std::string& flags, const std::string& more) {
+        if (!more.empty() && (" " + flags + " ").find(" " + more + " ") == std::string::npos) {
+            flags.append(flags.empty() ? "" : " ").append(more);
+        }
+    };
+    for (auto index : firedRules) {
+        const auto& rule{(*config->rules)[index]};
+        add(info.flags, rule.flags);
+        add(info.linkflags, rule.linkflags);
+        if (!rule.libraries.empty() && std::find(info.libraries.begin(), info.libraries.end(), rule.libraries) == info.libraries.end()) {
+            info.libraries.push_back(rule.libraries);
+        }
+    }
+    return info;
+}
+
+void AutoProject::addSource(const fs::path& filename) {
+    if (!hasSource(filename)) {
+        srcnames.emplace_back(filename.filename().string());
+        if (limits.maxOutputFiles && srcnames.size() > limits.maxOutputFiles) {
+            throw LimitExceeded("MaxOutputFiles", limits.maxOutputFiles, srcnames.size(), lineNumber);
+        }
+    }
+}
+
+void AutoProject::checkLimits(const std::string& line, std::chrono::steady_clock::time_point start) const {
+    // checked before the line is matched against any rule
+    if (limits.maxLineLength && line.size() > limits.maxLineLength) {
+        throw LimitExceeded("MaxLineLength", limits.maxLineLength, line.size(), lineNumber);
+    }
+    if (limits.timeout.count()) {
+        const auto elapsed{std::chrono::steady_clock::now() - start};
+        if (elapsed > limits.timeout) {
+            const auto ms{std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()};
+            throw LimitExceeded("ProjectTimeoutMs", static_cast<std::uintmax_t>(limits.timeout.count()), 
+                    static_cast<std::uintmax_t>(ms), lineNumber);
+        }
+    }
+}
+
+void AutoProject::addOutput(std::size_t bytes) {
+    outputBytes += bytes;
+    if (limits.maxOutputBytes && outputBytes > limits.maxOutputBytes) {
+        throw LimitExceeded("MaxOutputBytes", limits.maxOutputBytes, outputBytes, lineNumber);
+    }
+}
+
+bool AutoProject::hasSource(const fs::path& filename) const {
+    const auto name{filename.filename().string()};
+    return std::find(srcnames.begin(), srcnames.end(), std::string_view{name}) != srcnames.end();
+}
+
+void AutoProject::startFile() {
+    tokenizer.reset(config ? config->dialect : SourceDialect::c);
 }
 
 void AutoProject::checkRules(const std::string &line) {
-    std::smatch sm;
-    for (const auto &rule : rules) {
-        if (std::regex_search(line, sm, rule.re)) {
-            extraRules.emplace(rule.cmake);
-            libraries.emplace(rule.libraries);
+    if (config && config->rules) {
+        checkRules(tokenizer.next(line), *config->rules);
+    }
+}
+
+void AutoProject::checkRules(const SourceLine &line, const RuleSet &rules) {
+    fired.resize(rules.size());
+    for (std::size_t i{0}; i < rules.size(); ++i) {
+        // a rule only needs to fire once per project
+        if (!fired[i] && rules[i].matches(line)) {
+            fired[i] = true;
+            firedRules.push_back(i);
         }
     }
 }
@@ -265,29 +986,34 @@ void AutoProject::checkRules(const std::string &line) {
 void AutoProject::checkLanguageTags(const std::string& line) {
     if (!thislang.empty()) 
         return;
-    static const std::regex tagcpp{"### tags: \\[.*'c\\+\\+.*\\]"}; 
-    static const std::regex tagc{"### tags: \\[.*'c'.*\\]"}; 
-    static const std::regex tagasm{"### tags: \\[.*'assembly'.*\\]"}; 
-    std::smatch pieces;
-    if (std::regex_match(line, pieces, tagcpp)) {
-        thislang = "c++";
-    } else if (std::regex_match(line, pieces, tagc)) {
-        thislang = "c";
-    } else if (std::regex_match(line, pieces, tagasm)) {
-        thislang = "asm";
-    } else {
+    auto tags{parseTags(line)};
+    if (tags.empty()) {
         return;
     }
-    rules = loadrules(lang[thislang].rulesfilename);
-    configdir = lang[thislang].configdir;
-    toplevelfilename = lang[thislang].toplevelcmakefilename;
-    srclevelfilename = lang[thislang].srclevelcmakefilename;
-    clonedir = lang[thislang].clonedir;
+    for (const auto& language : languageTags) {
+        for (const auto tag : tags) {
+            if (tag == language.tag || (language.prefix && tag.starts_with(language.tag))) {
+                thislang = language.lang;
+                if (snapshot) {
+                    // already loaded, so there is nothing to lock
+                    if (auto it{snapshot->lang.find(std::string{thislang})}; it != snapshot->lang.end()) {
+                        config = &it->second;
+                    }
+                } else if (auto it{lang->find(std::string{thislang})}; it != lang->end()) {
+                    loadLanguage(it->second);
+                    config = &it->second;
+                }
+                return;
+            }
+        }
+    }
 }
 
 std::ostream& operator<<(std::ostream& out, const AutoProject &ap) {
     out << "Successfully extracted the following source files to " << ap.outdir << ":\n";
-    std::copy(ap.srcnames.begin(), ap.srcnames.end(), std::ostream_iterator<fs::path>(out, "\n"));
+    for (const auto& name : ap.srcnames) {
+        out << std::quoted(name) << '\n';
+    }
     return out;
 }
 
@@ -299,6 +1025,30 @@ bool isSourceExtension(const std::string_view ext) {
     return source_extensions.find(ext) != source_extensions.end();
 }
 
+bool isTranslationUnit(const fs::path& filename) {
+    static const std::unordered_set<std::string_view> header_extensions{".h", ".hpp"};
+    const auto ext{filename.extension().string()};
+    return isSourceExtension(ext) && !header_extensions.contains(ext);
+}
+
+std::string cmakeTargetName(std::string_view projname) {
+    // from CMake policy CMP0037; the generators' own targets
+    static const std::unordered_set<std::string_view> reserved{
+        "all", "clean", "help", "install", "test", "package", "package_source", "edit_cache", 
+        "rebuild_cache", "list_install_components", "ALL_BUILD", "ZERO_CHECK", "INSTALL", "RUN_TESTS", "PACKAGE"
+    };
+    std::string name{projname.empty() ? "_" : projname};
+    for (auto& ch : name) {
+        if (!std::isalnum(static_cast<unsigned char>(ch)) && ch != '_' && ch != '.' && ch != '+' && ch != '-') {
+            ch = '_';
+        }
+    }
+    if (reserved.contains(name)) {
+        name.push_back('_');
+    }
+    return name;
+}
+
 bool isSourceFilename(std::string &line) {
     trimExtras(line);
     return isSourceExtension(fs::path(line).extension().string());
@@ -359,40 +1109,32 @@ std::string &replaceLeadingTabs(std::string &line) {
     return line;
 }
 
-void emit(std::ostream& out, const std::string &line) {
-    if (line.size() < indentLevel) {
-        out << line << '\n';
-    } else {
-        out << (line[0] == ' ' ? line.substr(indentLevel) : line.substr(1)) << '\n';
-    }
-}
-
-std::vector<Rule> loadrules(const fs::path &rulesfile) {
-    std::vector<Rule> rules;
-    std::ifstream in(rulesfile);
-    if (!in) {
-        std::cerr << "Unable to open rules file: " << rulesfile << "\n";
-        return rules;
-    }
-    std::string line;
-    unsigned linenum{0};
-    static const std::regex rulefields{"([^@]+)@([^@]*)@(.*)"}; 
-    while (std::getline(in, line)) {
-        ++linenum;
-        std::smatch pieces;
-        if (std::regex_match(line, pieces, rulefields) && pieces.size() == 4) {
-            try {
-                rules.emplace_back(pieces[1], pieces[2], pieces[3]);
-            } 
-            catch (const std::regex_error& e) {
-                static constexpr std::string_view labels[4]{"line", "regex", "cmake lines", "libraries"};
-                std::cerr << "Error: " << e.what() << " in line " << linenum << " of rules file " << rulesfile << "\n";
-                for (unsigned i{0}; i < pieces.size(); ++i ) {
-                    std::cout << labels[i] << " = \"" << pieces[i] << "\"\n";
-                }
-            }
+/*
+ * Returns the tags from a line such as "### tags: ['c++', 'beginner']", 
+ * or none if the line is not a tags header.
+ */
+std::vector<std::string_view> parseTags(std::string_view line) {
+    std::vector<std::string_view> tags;
+    if (!line.starts_with(tagsHeader) || !line.ends_with(']')) {
+        return tags;
+    }
+    line.remove_prefix(tagsHeader.size());
+    line.remove_suffix(1);
+    while (!line.empty()) {
+        auto comma{line.find(',')};
+        auto tag{line.substr(0, comma)};
+        auto first{tag.find_first_not_of(" '\"")};
+        if (first != std::string_view::npos) {
+            tags.push_back(tag.substr(first, tag.find_last_not_of(" '\"") + 1 - first));
         }
+        line.remove_prefix(comma == std::string_view::npos ? line.size() : comma + 1);
+    }
+    return tags;
+}
+
+std::string_view unindent(const std::string &line) {
+    if (line.size() < indentLevel) {
+        return line;
     }
-    std::cout << "Loaded " << rules.size() << " rules\n";
-    return rules;
+    return std::string_view{line}.substr(line[0] == ' ' ? indentLevel : 1);
 }
@@ -1,23 +1,30 @@
 #ifndef AUTOPROJECT_H
 #define AUTOPROJECT_H
 #include "config.h"
+#include "CompilerCache.h"
+#include "ConfigFile.h"
+#include "EmbeddedConfig.h"
+#include "OutputWriter.h"
+#include "Rule.h"
+#include "SourceTokenizer.h"
+#include "Template.h"
+#include <chrono>
+#include <cstdint>
 #include <exception>
 #include <fstream>
 #include <functional>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
 #include <string>
 #include <string_view>
-#include <unordered_set>
+#include <vector>
 #include <filesystem>
 
 namespace fs = std::filesystem;
 
-struct path_hash {
-    std::size_t operator()(const fs::path &path) const {
-        return hash_value(path);
-    }
-};
-
 class FileExtensionException : public std::runtime_error
 {
 public:
@@ -26,34 +33,280 @@ public:
     {}
 };
 
+/*! Thrown when extracting a project would exceed one of its 
+ * `ExtractionLimits`.
+ *
+ * The setting, its value and the amount which exceeded it are kept so
+ * that callers can report them as more than a message.
+ */
+class LimitExceeded : public std::runtime_error
+{
+public:
+    LimitExceeded(std::string limit, std::uintmax_t allowed, std::uintmax_t actual, std::size_t line = 0);
+    /// the name of the setting, e.g. "MaxLineLength"
+    const std::string& limit() const { return name; }
+    std::uintmax_t allowed() const { return limitValue; }
+    std::uintmax_t actual() const { return actualValue; }
+    /// the line of the input at which the limit was exceeded, or 0 if none
+    std::size_t line() const { return lineNumber; }
+
+private:
+    std::string name;
+    std::uintmax_t limitValue;
+    std::uintmax_t actualValue;
+    std::size_t lineNumber;
+};
+
+/*! Bounds on the work done to extract one project, so that a single 
+ * pathological input can't stall a whole batch.
+ *
+ * A limit of zero means no limit.
+ */
+struct ExtractionLimits {
+    // size of the .md file
+    std::uintmax_t maxInputBytes{0};
+    // length of a line, which bounds the cost of matching it to the rules
+    std::size_t maxLineLength{0};
+    // number of source files extracted
+    std::size_t maxOutputFiles{0};
+    // total size of the source files extracted
+    std::uintmax_t maxOutputBytes{0};
+    // time allowed from the start of the extraction
+    std::chrono::milliseconds timeout{0};
+};
+
+/*! Where each project's directory goes.
+ *
+ * By default a project is put next to its .md file and named for it.
+ * With a `root`, projects go under that directory instead.  With `levels`
+ * of fan-out, they go that many subdirectories further down, each named
+ * by the next two hex digits of the `stableHash` of the project name, 
+ * e.g. `out/fa/a9/248232`, so that no one directory grows too large.  
+ * The path depends only on the name, so other tools can find a project
+ * without searching for it.
+ */
+struct OutputLayout {
+    static constexpr unsigned maxLevels{8};
+    fs::path root;
+    unsigned levels{0};
+    /// the output directory of the project extracted from `mdfile`
+    fs::path directory(const fs::path& mdfile) const;
+};
+
+/*! Settings for one language.
+ *
+ * An empty file name means the built-in default from `builtin` is used.
+ */
 struct LangConfig {
     fs::path configdir;
     fs::path rulesfilename;
     fs::path toplevelcmakefilename;
     fs::path srclevelcmakefilename;
     fs::path clonedir;
+    // built-in defaults for this language, if any
+    const EmbeddedLanguage *builtin{nullptr};
+    // if not empty, the built-in contents of clonedir
+    std::span<const EmbeddedFile> clonefiles;
+    // a directory cloned, and added to the top level CMakeLists.txt, only
+    // for projects with a performance harness, and its built-in contents
+    fs::path harnessdir;
+    std::span<const EmbeddedFile> harnessfiles;
+    // for building the extracted sources without CMake, e.g. by --check
+    std::string compiler;
+    std::string compileflags;
+    std::string syntaxcheckflags;
+    std::string linker;
+    std::string linkflags;
+    // what the rules take as comments and directives in the sources
+    SourceDialect dialect{SourceDialect::c};
+    // the compiler cache, the same for every language, and the CMake 
+    // languages, e.g. "C CXX", whose compilers it wraps
+    std::shared_ptr<const CompilerCache> cache;
+    std::string launcherlanguages;
+    // compiled rules and templates, shared by every project using this language
+    std::shared_ptr<const RuleSet> rules;
+    std::shared_ptr<const Template> toplevel;
+    std::shared_ptr<const Template> srclevel;
+};
+
+/// the built-in settings for each language
+std::map<std::string, LangConfig> builtinLanguageSettings();
+/*! apply the per-language sections of the configuration file to the
+ * built-in settings.
+ *
+ * Only the values present in the configuration file replace the defaults.
+ * If `profile` is neither empty nor "full", the sections named for it,
+ * e.g. `[c++.lean]`, are then applied on top; the built-in "lean" profile
+ * clones no directories.  Throws if no section names the profile.
+ * The compiler cache is chosen from the `CompilerLauncher` and 
+ * `CompilerCacheDir` settings of the General section.
+ */
+std::map<std::string, LangConfig> fetchLanguageSettings(const ConfigFile &cfg, const std::string& profile = {});
+/*! compile the rules and read the templates for one language, if not 
+ * already done.
+ *
+ * Languages are loaded when a project first needs them and then kept, so
+ * configuring many languages costs nothing until they are used.  It is
+ * safe to call this from several threads at once.
+ */
+void loadLanguage(LangConfig& lang);
+/*! load the rules and templates for every language up front.
+ *
+ * Every project extracted using the map shares them, so a long-running
+ * process pays for reading and compiling each language's files only once.
+ * Unlike a language loaded when it is needed, one whose rules file can't
+ * be read is an error rather than a language without rules.
+ */
+void preloadLanguages(std::map<std::string, LangConfig>& lang);
+/*! read the `MaxInputBytes`, `MaxLineLength`, `MaxOutputFiles`, 
+ * `MaxOutputBytes` and `ProjectTimeoutMs` settings of the General section.
+ */
+ExtractionLimits fetchExtractionLimits(const ConfigFile &cfg);
+/*! read the `OutputRoot` and `OutputFanout` settings of the General 
+ * section, throwing if the fan-out is not a number from 0 to 
+ * `OutputLayout::maxLevels`.
+ */
+OutputLayout fetchOutputLayout(const ConfigFile &cfg);
+
+/*! What it takes to compile an extracted project without CMake.
+ *
+ * Flags are space separated, as they would be written on a command line.
+ */
+struct BuildInfo {
+    std::string projname;
+    // the name of the project and its executable in CMake
+    std::string target;
+    fs::path outdir;
+    fs::path srcdir;
+    // detected language, or empty if none was found
+    std::string lang;
+    // every extracted file, headers included, in the order first written
+    std::vector<fs::path> sources;
+    std::string compiler;
+    // words to put before the compiler, e.g. to use ccache, or empty
+    std::string launcher;
+    // the language's flags followed by those of each rule which fired
+    std::string flags;
+    std::string syntaxcheckflags;
+    std::string linker;
+    // the language's link flags followed by those of each rule which fired
+    std::string linkflags;
+    // the libraries of each rule which fired, each once
+    std::vector<std::string> libraries;
 };
 
+/// returns true if `filename` is compiled on its own rather than included
+bool isTranslationUnit(const fs::path& filename);
+/*! `projname` as a CMake target name: any character CMake doesn't allow
+ * becomes '_', as does an empty name, and a name CMake reserves, such as
+ * "test", gets a '_' appended.
+ */
+std::string cmakeTargetName(std::string_view projname);
+
+struct ConfigSnapshot;
+
+/*! Extracts one project from a markdown file.
+ *
+ * The language settings are shared, not copied, and must outlive the
+ * `AutoProject`.  All other per-project state is allocated from `arena`,
+ * so a batch process can give each extraction a monotonic arena and 
+ * release it afterwards rather than churning the heap.
+ */
 class AutoProject {
 public:
     AutoProject() = default;
-    AutoProject(fs::path mdFilename, std::map<std::string, LangConfig> lang);
-    void open(fs::path mdFilename, std::map<std::string, LangConfig> lang);
-    // create the project
-    bool createProject(bool overwrite);
+    AutoProject(fs::path mdFilename, std::map<std::string, LangConfig>& lang, 
+            std::pmr::memory_resource *arena = std::pmr::get_default_resource());
+    /*! extract from `contents` rather than reading `mdFilename`, which
+     * still names the project and its output directory.
+     */
+    AutoProject(fs::path mdFilename, std::string contents, std::map<std::string, LangConfig>& lang, 
+            std::pmr::memory_resource *arena = std::pmr::get_default_resource());
+    /*! extract with the languages, limits and output layout of `snapshot`,
+     * which the project keeps for as long as it exists.
+     */
+    AutoProject(fs::path mdFilename, std::shared_ptr<const ConfigSnapshot> snapshot,
+            std::pmr::memory_resource *arena = std::pmr::get_default_resource());
+    void open(fs::path mdFilename, std::map<std::string, LangConfig>& lang,
+            std::pmr::memory_resource *arena = std::pmr::get_default_resource());
+    /*! limit the work done by `createProject` and `scanCode`, which throw
+     * `LimitExceeded` if any limit is exceeded.
+     *
+     * Files already written directly to disk are left as they are, so a
+     * batch should extract into an `OutputBatch` to discard them.
+     */
+    void setLimits(const ExtractionLimits& newLimits) { limits = newLimits; }
+    /// put the project where `layout` says rather than next to the .md file
+    void setOutputLayout(const OutputLayout& layout);
+    /*! also create the language's performance harness, if it has one: an
+     * optimized build and a `perf` target which times the program.
+     */
+    void setPerfHarness(bool enable) { perfHarness = enable; }
+    /*! name the CMake project and executable `name` rather than for the
+     * project, e.g. to keep it unique among the projects of a superbuild.
+     */
+    void setTargetName(std::string_view name) { target.assign(name); }
+    /*! create the project
+     *
+     * If `pipelined` is set, scanning the input, checking the rules and
+     * writing the source files each run on a separate thread.  This is 
+     * only worthwhile for very large inputs; the result is the same.
+     */
+    bool createProject(bool overwrite, bool pipelined = false);
+    /*! create the project in `batch` rather than on disk.
+     *
+     * Whether the output directory already exists is still checked, but
+     * nothing is written until the batch is passed to an `OutputWriter`.
+     */
+    bool createProject(bool overwrite, OutputBatch& batch);
+    /*! scan the input as `createProject` would, but write nothing.
+     *
+     * Each line of code is passed to `visit`, tokenized as the rules see
+     * it, with the rules of the language detected so far, or nullptr if
+     * none has been.
+     */
+    void scanCode(const std::function<void(const SourceLine& line, const RuleSet *rules)>& visit);
+    /// compiler, flags and sources of the project; valid after `createProject`
+    BuildInfo buildInfo() const;
     /// print final status to `out`
     friend std::ostream& operator<<(std::ostream& out, const AutoProject &ap);
 
 private:
-    void writeTopLevel() const;
+    AutoProject(fs::path mdFilename, std::map<std::string, LangConfig> *lang, std::pmr::memory_resource *arena,
+            std::optional<std::string> contents);
+    struct DirectSink;
+    struct PipelinedSink;
+    struct CodeSink;
+    struct BatchSink;
+    /// run the extraction state machine, passing source lines to `sink`
+    template <typename Sink>
+    void scan(bool overwrite, Sink& sink);
+    std::string topLevel() const;
+    std::string srcLevel() const;
     void copyCloneDir(bool overwrite) const;
-    void writeSrcLevel() const;
-    void makeTree(bool overwrite);
+    void copyCloneDir(OutputBatch& batch) const;
+    /// copy `dir`, or the built-in `files` if there are any, into the project
+    void copyDir(const fs::path& dir, std::span<const EmbeddedFile> files, bool overwrite) const;
+    void copyDir(const fs::path& dir, std::span<const EmbeddedFile> files, OutputBatch& batch) const;
+    /// check the output directory and create it, or add it to `batch`
+    void makeTree(bool overwrite, OutputBatch *batch = nullptr);
+    /// record an extracted file name, once
+    void addSource(const fs::path& filename);
+    /// throw if the line just read, or the time taken so far, is over the limits
+    void checkLimits(const std::string& line, std::chrono::steady_clock::time_point deadline) const;
+    /// count `bytes` more of output, throwing if that is over the limit
+    void addOutput(std::size_t bytes);
+    bool hasSource(const fs::path& filename) const;
+    /// start tokenizing a new source file in the language detected so far
+    void startFile();
     /*! check the passed line against the rule set.
      *
-     * If it matches, add the corresponding rule to `extraRules`.
+     * If it matches a rule which has not already fired, add the index of
+     * that rule to `firedRules`.  The first form tokenizes the line as
+     * the next line of the current source file.
      */
     void checkRules(const std::string &line);
+    void checkRules(const SourceLine &line, const RuleSet &rules);
     void checkLanguageTags(const std::string& line);
 
     // full path to input md file, e.g. "/tmp/248232.md"
@@ -61,17 +314,31 @@ private:
     // output directory name, e.g. "/tmp/248232"
     fs::path outdir;
     // project name, e.g. "248232"
-    std::string projname;
-    std::string srcdir;
-    std::ifstream in;
-    fs::path configdir;
-    fs::path toplevelfilename;
-    fs::path srclevelfilename;
-    fs::path clonedir;
-    std::unordered_set<fs::path, path_hash> srcnames;
-    std::unordered_set<std::string> extraRules;
-    std::unordered_set<std::string> libraries;
-    std::string thislang;
-    std::map<std::string, LangConfig> lang;
+    std::pmr::string projname;
+    // its name in CMake, usually the same
+    std::pmr::string target;
+    std::pmr::string srcdir;
+    // the contents of the input, if given in memory rather than as a file
+    std::optional<std::string> mdtext;
+    // reads either `mdtext` or `mdfile`; released once the input is scanned
+    std::unique_ptr<std::istream> in;
+    // languages loaded as needed, or nullptr if using `snapshot`
+    std::map<std::string, LangConfig> *lang{nullptr};
+    std::shared_ptr<const ConfigSnapshot> snapshot;
+    // settings for the detected language, or nullptr if not yet known
+    const LangConfig *config{nullptr};
+    std::pmr::string thislang;
+    // extracted file names, in the order first written
+    std::pmr::vector<std::pmr::string> srcnames;
+    // indices into the language's rules of the rules which fired, in order
+    std::pmr::vector<std::size_t> firedRules;
+    std::pmr::vector<bool> fired;
+    // follows the comments and directives of the source file being written
+    SourceTokenizer tokenizer;
+    ExtractionLimits limits;
+    bool perfHarness{false};
+    // input lines read and source bytes extracted so far
+    std::size_t lineNumber{0};
+    std::uintmax_t outputBytes{0};
 };
 #endif // AUTOPROJECT_H
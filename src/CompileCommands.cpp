@@ -0,0 +1,46 @@
+#include "CompileCommands.h"
+#include "Json.h"
+#include <sstream>
+
+std::vector<std::string> compileArguments(const BuildInfo& project, const fs::path& source, const fs::path& object) {
+    std::vector<std::string> args;
+    std::istringstream words{project.compiler + ' ' + project.flags};
+    for (std::string word; words >> word; ) {
+        args.push_back(std::move(word));
+    }
+    if (project.lang == "asm") {
+        // nasm has no -c and takes a separator on the include directory
+        args.insert(args.end(), {"-I", project.srcdir.string() + "/", "-o", object.string(), source.string()});
+    } else {
+        args.insert(args.end(), {"-I", project.srcdir.string(), "-c", source.string(), "-o", object.string()});
+    }
+    return args;
+}
+
+void writeCompileCommands(std::ostream& out, const BuildInfo& project) {
+    auto absolute{project};
+    absolute.outdir = fs::absolute(project.outdir).lexically_normal();
+    absolute.srcdir = fs::absolute(project.srcdir).lexically_normal();
+    const auto directory{Json::quote(absolute.outdir.string())};
+    out << "[";
+    const char *separator{"\n"};
+    for (const auto& source : project.sources) {
+        if (!isTranslationUnit(source)) {
+            continue;
+        }
+        const auto file{absolute.srcdir / source.filename()};
+        const auto object{absolute.outdir / "build" / (source.filename().string() + ".o")};
+        out << separator << "  {\"directory\": " << directory
+            << ", \"file\": " << Json::quote(file.string())
+            << ", \"output\": " << Json::quote(object.string())
+            << ", \"arguments\": [";
+        const char *comma{""};
+        for (const auto& arg : compileArguments(absolute, file, object)) {
+            out << comma << Json::quote(arg);
+            comma = ", ";
+        }
+        out << "]}";
+        separator = ",\n";
+    }
+    out << "\n]\n";
+}
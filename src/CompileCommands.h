@@ -0,0 +1,24 @@
+#ifndef COMPILECOMMANDS_H
+#define COMPILECOMMANDS_H
+#include "AutoProject.h"
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*! the arguments which compile `source`, one of the project's translation
+ * units, into `object`, as `writeNinjaFile` would.
+ *
+ * The compiler launcher, if any, is left out, so that tools which read
+ * the arguments see the compiler itself.
+ */
+std::vector<std::string> compileArguments(const BuildInfo& project, const fs::path& source, const fs::path& object);
+
+/*! write a `compile_commands.json` for `project`, with one entry for each
+ * translation unit, so that tools such as clangd and clang-tidy can be
+ * used on it without configuring it with CMake first.
+ *
+ * The paths are absolute, as the format requires, and the directory of
+ * each command is the project's output directory.
+ */
+void writeCompileCommands(std::ostream& out, const BuildInfo& project);
+#endif // COMPILECOMMANDS_H
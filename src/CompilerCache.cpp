@@ -0,0 +1,121 @@
+#include "CompilerCache.h"
+#include <cstdlib>
+#include <sstream>
+
+#ifdef _WIN32
+static constexpr char pathSeparator{';'};
+#else
+static constexpr char pathSeparator{':'};
+#endif
+
+// quote a CMake argument so that nothing in it is expanded
+static std::string cmakeQuote(std::string_view text) {
+    std::string quoted{"\""};
+    for (char ch : text) {
+        if (ch == '\\' || ch == '"' || ch == '$') {
+            quoted.push_back('\\');
+        }
+        quoted.push_back(ch);
+    }
+    return quoted + '"';
+}
+
+// quote a word for the POSIX shell
+static std::string shellQuote(std::string_view text) {
+    std::string quoted{"'"};
+    for (char ch : text) {
+        if (ch == '\'') {
+            quoted += "'\\''";
+        } else {
+            quoted.push_back(ch);
+        }
+    }
+    return quoted + '\'';
+}
+
+std::string_view CompilerCache::cachedirVariable() const {
+    const auto name{kind()};
+    if (name == "ccache") {
+        return "CCACHE_DIR";
+    }
+    if (name == "sccache") {
+        return "SCCACHE_DIR";
+    }
+    return {};
+}
+
+std::string CompilerCache::cmake(std::string_view languages) const {
+    if (launcher.empty()) {
+        return {};
+    }
+    std::string words;
+    if (!cachedir.empty() && !cachedirVariable().empty()) {
+        words = "\"${CMAKE_COMMAND}\" -E env " 
+            + cmakeQuote(std::string{cachedirVariable()} + "=" + cachedir.generic_string()) + " ";
+    }
+    words += cmakeQuote(launcher.generic_string());
+    std::string text;
+    std::istringstream in{std::string{languages}};
+    for (std::string language; in >> language; ) {
+        text.append(text.empty() ? "" : "\n").append("set(CMAKE_" + language + "_COMPILER_LAUNCHER " + words + ")");
+    }
+    return text;
+}
+
+std::string CompilerCache::command() const {
+    if (launcher.empty()) {
+        return {};
+    }
+    std::string words;
+    if (!cachedir.empty() && !cachedirVariable().empty()) {
+        words = std::string{cachedirVariable()} + "=" + shellQuote(cachedir.string()) + " ";
+    }
+    return words + shellQuote(launcher.string());
+}
+
+fs::path findProgram(std::string_view program) {
+    const char *path{std::getenv("PATH")};
+    if (!path) {
+        return {};
+    }
+    std::string_view dirs{path};
+    while (!dirs.empty()) {
+        const auto end{dirs.find(pathSeparator)};
+        const auto dir{dirs.substr(0, end)};
+        if (!dir.empty()) {
+#ifdef _WIN32
+            const fs::path candidate{fs::path{dir} / (std::string{program} + ".exe")};
+#else
+            const fs::path candidate{fs::path{dir} / program};
+#endif
+            std::error_code ec;
+            if (fs::is_regular_file(candidate, ec)) {
+                return candidate;
+            }
+        }
+        dirs.remove_prefix(end == std::string_view::npos ? dirs.size() : end + 1);
+    }
+    return {};
+}
+
+CompilerCache findCompilerCache(std::string_view setting, const fs::path& cachedir) {
+    CompilerCache cache;
+    if (setting == "auto") {
+        for (auto program : {"ccache", "sccache"}) {
+            if (cache.launcher = findProgram(program); !cache.launcher.empty()) {
+                break;
+            }
+        }
+    } else if (!setting.empty() && setting != "none") {
+        // a bare name is looked for on the PATH, but kept even if not found
+        const fs::path named{setting};
+        cache.launcher = named.has_parent_path() ? named : findProgram(setting);
+        if (cache.launcher.empty()) {
+            cache.launcher = named;
+        }
+    }
+    if (!cache.launcher.empty()) {
+        cache.cachedir = cachedir;
+    }
+    return cache;
+}
@@ -0,0 +1,46 @@
+#ifndef COMPILERCACHE_H
+#define COMPILERCACHE_H
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace fs = std::filesystem;
+
+/*! A compiler launcher, such as ccache or sccache, for the generated
+ * projects to build through.
+ *
+ * It is set as CMake's `CMAKE_<LANG>_COMPILER_LAUNCHER` for each of the
+ * project's languages and used in front of the compiler in `build.ninja`.
+ * If `cachedir` is set, every build is pointed at it, so projects built
+ * anywhere on a farm can share one cache.
+ */
+struct CompilerCache {
+    // the launcher program, or empty if there is none
+    fs::path launcher;
+    // the cache directory to use rather than the launcher's default
+    fs::path cachedir;
+
+    explicit operator bool() const { return !launcher.empty(); }
+    /// the file name of the launcher without extension, e.g. "ccache"
+    std::string kind() const { return launcher.stem().string(); }
+    /// the environment variable naming the cache directory, or empty if unknown
+    std::string_view cachedirVariable() const;
+    /*! the CMake which sets the launcher for each of `languages`, which are
+     * space separated, e.g. "C CXX"; empty if there is no launcher
+     */
+    std::string cmake(std::string_view languages) const;
+    /// the shell words to put before a compiler command
+    std::string command() const;
+};
+
+/// search the PATH for `program`, returning an empty path if it's not found
+fs::path findProgram(std::string_view program);
+/*! choose the launcher from the `CompilerLauncher` setting.
+ *
+ * No setting, or "none", uses no launcher, so that the generated projects
+ * don't depend on what this machine has installed; "auto" uses ccache
+ * or else sccache if either is on the PATH; anything else is the name or
+ * path of the launcher to use.
+ */
+CompilerCache findCompilerCache(std::string_view setting, const fs::path& cachedir);
+#endif // COMPILERCACHE_H
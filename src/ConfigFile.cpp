@@ -18,7 +18,9 @@ static std::string tolower(std::string str) {
 
 static const std::regex comment_regex{R"x(\s*[;#].*)x"};
 static const std::regex section_regex{R"x(\s*\[([^\]]+)\]\s*)x"};
-static const std::regex value_regex{R"x(\s*(\S[^ \t=]*)\s*=\s*((\s?\S+)+)\s*)x"};
+// each word of the value is preceded by exactly one space, so a value
+// which fails to match can't cause exponential backtracking
+static const std::regex value_regex{R"x(\s*(\S[^ \t=]*)\s*=\s*(\S+(\s\S+)*)\s*)x"};
 
 ConfigFile::ConfigFile(const std::string& filename)
 : map{} {
@@ -0,0 +1,103 @@
+#include "ConfigSnapshot.h"
+#include <fstream>
+#include <system_error>
+
+// when `path` was last written, or the earliest time if it doesn't exist
+static fs::file_time_type writeTime(const fs::path& path) {
+    std::error_code ec;
+    const auto when{fs::last_write_time(path, ec)};
+    return ec ? fs::file_time_type::min() : when;
+}
+
+ConfigSnapshot::ConfigSnapshot(ConfigFile cfg, std::uint64_t version, Sources sources) :
+    version{version},
+    cfg{std::move(cfg)},
+    sources{std::move(sources)}
+{
+    lang = fetchLanguageSettings(this->cfg, this->cfg.get_value("General", "Profile"));
+    limits = fetchExtractionLimits(this->cfg);
+    layout = fetchOutputLayout(this->cfg);
+    // noted before reading, so a change made while loading is seen next time
+    for (const auto& [name, config] : lang) {
+        for (const auto *file : {&config.rulesfilename, &config.toplevelcmakefilename, &config.srclevelcmakefilename}) {
+            if (!file->empty()) {
+                this->sources.emplace_back(*file, writeTime(*file));
+            }
+        }
+    }
+    preloadLanguages(lang);
+}
+
+// `sources` as they are now
+static ConfigSnapshot::Sources writeTimes(const ConfigSnapshot::Sources& sources) {
+    ConfigSnapshot::Sources now;
+    for (const auto& [path, when] : sources) {
+        now.emplace_back(path, writeTime(path));
+    }
+    return now;
+}
+
+ConfigStore::ConfigStore(fs::path configfile, Adjust adjust) :
+    configfile{std::move(configfile)},
+    adjust{std::move(adjust)}
+{
+    const auto when{writeTime(this->configfile)};
+    publish(std::make_shared<const ConfigSnapshot>(read(), 1, ConfigSnapshot::Sources{{this->configfile, when}}));
+}
+
+ConfigStore::ConfigStore(ConfigFile cfg) :
+    fixed{std::move(cfg)}
+{
+    publish(std::make_shared<const ConfigSnapshot>(*fixed, 1));
+}
+
+std::shared_ptr<const ConfigSnapshot> ConfigStore::current() const {
+    return latest.load(std::memory_order_acquire);
+}
+
+void ConfigStore::update(std::shared_ptr<const ConfigSnapshot>& snapshot) const {
+    if (!snapshot || snapshot->version != version()) {
+        snapshot = current();
+    }
+}
+
+bool ConfigStore::refresh() {
+    std::lock_guard<std::mutex> lock{reloading};
+    const auto previous{current()};
+    auto now{writeTimes(previous->sources)};
+    if (now == previous->sources || now == rejected) {
+        return false;
+    }
+    ConfigSnapshot::Sources sources;
+    if (!fixed) {
+        sources.emplace_back(configfile, writeTime(configfile));
+    }
+    try {
+        publish(std::make_shared<const ConfigSnapshot>(read(), previous->version + 1, std::move(sources)));
+    }
+    catch(...) {
+        // not tried again until something changes
+        rejected = std::move(now);
+        throw;
+    }
+    return true;
+}
+
+ConfigFile ConfigStore::read() const {
+    if (fixed) {
+        return *fixed;
+    }
+    // without a configuration file, the built-in defaults are used
+    std::ifstream in{configfile};
+    ConfigFile cfg{in};
+    if (adjust) {
+        adjust(cfg);
+    }
+    return cfg;
+}
+
+void ConfigStore::publish(std::shared_ptr<const ConfigSnapshot> snapshot) {
+    const auto newVersion{snapshot->version};
+    latest.store(std::move(snapshot), std::memory_order_release);
+    latestVersion.store(newVersion, std::memory_order_release);
+}
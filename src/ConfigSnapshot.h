@@ -0,0 +1,99 @@
+#ifndef CONFIGSNAPSHOT_H
+#define CONFIGSNAPSHOT_H
+#include "AutoProject.h"
+#include "ConfigFile.h"
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/*! One version of everything read from the configuration: the settings,
+ * the languages with their compiled rules and templates, and the limits
+ * and layout which follow from them.
+ *
+ * A snapshot never changes once it is built and every language in it is
+ * already loaded, so any number of threads may extract with it at once
+ * without locking.  The settings are those of the `Profile` in `cfg`.
+ */
+struct ConfigSnapshot {
+    using Sources = std::vector<std::pair<fs::path, fs::file_time_type>>;
+    /*! build a snapshot from `cfg`, throwing if any of it is bad.
+     *
+     * `sources` are the files `cfg` itself was read from; the rules and
+     * templates of each language are added to them.
+     */
+    ConfigSnapshot(ConfigFile cfg, std::uint64_t version, Sources sources = {});
+
+    // 1 for the first snapshot, one more for each reload
+    std::uint64_t version;
+    ConfigFile cfg;
+    std::map<std::string, LangConfig> lang;
+    ExtractionLimits limits;
+    OutputLayout layout;
+    // each file the snapshot was read from, and when it was last written
+    Sources sources;
+};
+
+/*! Publishes the latest `ConfigSnapshot` and replaces it when the files
+ * it was read from change.
+ *
+ * This works like read-copy-update: a reload builds a whole new snapshot
+ * and then swaps it in, so readers never see a partly read configuration.
+ * An extraction holds on to the snapshot it started with, which is freed
+ * when the last such extraction finishes.  Readers never take a lock:
+ * `current` is an atomic load of the snapshot pointer, and a reader that
+ * keeps its snapshot between extractions and calls `update` only loads
+ * the pointer when there is a newer one, otherwise checking the version.
+ */
+class ConfigStore {
+public:
+    /// applied to the configuration each time it is read, e.g. for command line overrides
+    using Adjust = std::function<void(ConfigFile&)>;
+    /*! read `configfile`, or use the built-in defaults if there is no
+     * such file, throwing if the configuration is bad.
+     */
+    explicit ConfigStore(fs::path configfile, Adjust adjust = {});
+    /// use `cfg` as it is; only its rules and templates are ever reloaded
+    explicit ConfigStore(ConfigFile cfg);
+    ConfigStore(const ConfigStore&) = delete;
+    ConfigStore& operator=(const ConfigStore&) = delete;
+    /// the latest snapshot
+    std::shared_ptr<const ConfigSnapshot> current() const;
+    /// replace `snapshot` with the latest one, if it is not already that
+    void update(std::shared_ptr<const ConfigSnapshot>& snapshot) const;
+    /// the version of the latest snapshot
+    std::uint64_t version() const { return latestVersion.load(std::memory_order_acquire); }
+    /*! read everything again and publish a new snapshot if any of the
+     * files have changed.  Returns true if it did.
+     *
+     * If the new configuration is bad, the latest snapshot stays in use
+     * and the error is thrown.  It is not read again until one of the 
+     * files changes again.
+     */
+    bool refresh();
+
+private:
+    ConfigFile read() const;
+    void publish(std::shared_ptr<const ConfigSnapshot> snapshot);
+
+    fs::path configfile;
+    Adjust adjust;
+    // the configuration given in place of `configfile`, if any
+    std::optional<ConfigFile> fixed;
+    // the files as they were when a reload last failed
+    ConfigSnapshot::Sources rejected;
+    // held while reloading, so only one thread reads the files and publishes
+    std::mutex reloading;
+    std::atomic<std::shared_ptr<const ConfigSnapshot>> latest;
+    std::atomic<std::uint64_t> latestVersion{0};
+};
+#endif // CONFIGSNAPSHOT_H
@@ -0,0 +1,36 @@
+#ifndef EMBEDDEDCONFIG_H
+#define EMBEDDEDCONFIG_H
+#include "Rule.h"
+#include "Template.h"
+#include <span>
+#include <string_view>
+
+/// a file to be cloned verbatim into each project
+struct EmbeddedFile {
+    // path relative to the clone directory
+    std::string_view path;
+    std::string_view contents;
+};
+
+/*! The shipped configuration of one language, compiled into the program.
+ *
+ * These tables are generated at build time from the files under `config`
+ * so that autoproject needs no data files unless they override these.
+ */
+struct EmbeddedLanguage {
+    // configuration file section name, e.g. "c++"
+    std::string_view name;
+    // subdirectory of the shipped configuration, e.g. "cpp"
+    std::string_view subdir;
+    std::span<const RuleFields> rules;
+    std::span<const Segment> toplevel;
+    std::span<const Segment> srclevel;
+    std::string_view clonedir;
+    std::span<const EmbeddedFile> clonefiles;
+    // cloned only when a performance harness is asked for
+    std::string_view harnessdir;
+    std::span<const EmbeddedFile> harnessfiles;
+};
+
+std::span<const EmbeddedLanguage> embeddedLanguages();
+#endif // EMBEDDEDCONFIG_H
@@ -0,0 +1,301 @@
+#include "Json.h"
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+
+using namespace std::literals;
+
+class Json::Parser {
+public:
+    explicit Parser(std::string_view text) : text{text} {}
+
+    Json document() {
+        Json result{value()};
+        skipSpace();
+        if (pos != text.size()) {
+            fail("unexpected text after value");
+        }
+        return result;
+    }
+
+private:
+    // deeper nesting is refused rather than recursing until the stack runs out
+    static constexpr unsigned maxDepth{256};
+
+    [[noreturn]] void fail(const std::string& msg) const {
+        throw JsonError("JSON error at offset " + std::to_string(pos) + ": " + msg);
+    }
+
+    void skipSpace() {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r')) {
+            ++pos;
+        }
+    }
+
+    bool consume(std::string_view token) {
+        if (text.substr(pos).starts_with(token)) {
+            pos += token.size();
+            return true;
+        }
+        return false;
+    }
+
+    Json value() {
+        skipSpace();
+        if (pos == text.size()) {
+            fail("unexpected end of input");
+        }
+        Json result;
+        switch (text[pos]) {
+            case '{': 
+                nest();
+                result.value = object(); 
+                --depth;
+                break;
+            case '[': 
+                nest();
+                result.value = array(); 
+                --depth;
+                break;
+            case '"': 
+                result.value = string(); 
+                break;
+            default:
+                if (consume("true")) {
+                    result.value = true;
+                } else if (consume("false")) {
+                    result.value = false;
+                } else if (consume("null")) {
+                    result.value = nullptr;
+                } else {
+                    result.value = number();
+                }
+        }
+        return result;
+    }
+
+    void nest() {
+        if (++depth > maxDepth) {
+            fail("nesting too deep");
+        }
+    }
+
+    Object object() {
+        Object members;
+        ++pos;
+        skipSpace();
+        if (consume("}")) {
+            return members;
+        }
+        do {
+            skipSpace();
+            if (pos == text.size() || text[pos] != '"') {
+                fail("expected member name");
+            }
+            auto key{string()};
+            skipSpace();
+            if (!consume(":")) {
+                fail("expected ':'");
+            }
+            members.emplace_back(std::move(key), value());
+            skipSpace();
+        } while (consume(","));
+        if (!consume("}")) {
+            fail("expected '}'");
+        }
+        return members;
+    }
+
+    Array array() {
+        Array elements;
+        ++pos;
+        skipSpace();
+        if (consume("]")) {
+            return elements;
+        }
+        do {
+            elements.push_back(value());
+            skipSpace();
+        } while (consume(","));
+        if (!consume("]")) {
+            fail("expected ']'");
+        }
+        return elements;
+    }
+
+    unsigned hex4() {
+        unsigned code{0};
+        auto [end, ec] = std::from_chars(text.data() + pos, text.data() + std::min(pos + 4, text.size()), code, 16);
+        if (ec != std::errc{} || end != text.data() + pos + 4) {
+            fail("bad \\u escape");
+        }
+        pos += 4;
+        return code;
+    }
+
+    static void appendUtf8(std::string& out, unsigned code) {
+        if (code < 0x80) {
+            out.push_back(static_cast<char>(code));
+        } else if (code < 0x800) {
+            out.push_back(static_cast<char>(0xc0 | (code >> 6)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+        } else if (code < 0x10000) {
+            out.push_back(static_cast<char>(0xe0 | (code >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+        } else {
+            out.push_back(static_cast<char>(0xf0 | (code >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+        }
+    }
+
+    std::string string() {
+        std::string result;
+        ++pos;
+        while (pos < text.size() && text[pos] != '"') {
+            char ch{text[pos++]};
+            if (ch != '\\') {
+                result.push_back(ch);
+                continue;
+            }
+            if (pos == text.size()) {
+                break;
+            }
+            switch (ch = text[pos++]) {
+                case 'b': result.push_back('\b'); break;
+                case 'f': result.push_back('\f'); break;
+                case 'n': result.push_back('\n'); break;
+                case 'r': result.push_back('\r'); break;
+                case 't': result.push_back('\t'); break;
+                case 'u': {
+                    unsigned code{hex4()};
+                    // combine a UTF-16 surrogate pair
+                    if (code >= 0xd800 && code < 0xdc00 && consume("\\u")) {
+                        unsigned low{hex4()};
+                        code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                    }
+                    appendUtf8(result, code);
+                    break;
+                }
+                default: result.push_back(ch); break;
+            }
+        }
+        if (!consume("\"")) {
+            fail("unterminated string");
+        }
+        return result;
+    }
+
+    double number() {
+        auto end{text.find_first_not_of("+-0123456789.eE", pos)};
+        std::string token{text.substr(pos, end == std::string_view::npos ? end : end - pos)};
+        char *last{nullptr};
+        double result{std::strtod(token.c_str(), &last)};
+        if (token.empty() || last != token.c_str() + token.size()) {
+            fail("unexpected character");
+        }
+        pos += token.size();
+        return result;
+    }
+
+    std::string_view text;
+    std::size_t pos{0};
+    // the objects and arrays open at `pos`
+    unsigned depth{0};
+};
+
+Json Json::parse(std::string_view text) {
+    return Parser{text}.document();
+}
+
+std::string Json::quote(std::string_view str) {
+    std::ostringstream out;
+    out << '"';
+    for (unsigned char ch : str) {
+        switch (ch) {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\b': out << "\\b"; break;
+            case '\f': out << "\\f"; break;
+            case '\n': out << "\\n"; break;
+            case '\r': out << "\\r"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (ch < 0x20) {
+                    out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<unsigned>(ch) << std::dec;
+                } else {
+                    out << ch;
+                }
+        }
+    }
+    out << '"';
+    return out.str();
+}
+
+const std::string& Json::asString() const {
+    if (auto str = std::get_if<std::string>(&value)) {
+        return *str;
+    }
+    throw JsonError("JSON value is not a string");
+}
+
+double Json::asNumber() const {
+    if (auto num = std::get_if<double>(&value)) {
+        return *num;
+    }
+    throw JsonError("JSON value is not a number");
+}
+
+bool Json::asBool() const {
+    if (auto b = std::get_if<bool>(&value)) {
+        return *b;
+    }
+    throw JsonError("JSON value is not a boolean");
+}
+
+const Json::Array& Json::asArray() const {
+    if (auto arr = std::get_if<Array>(&value)) {
+        return *arr;
+    }
+    throw JsonError("JSON value is not an array");
+}
+
+const Json::Object& Json::asObject() const {
+    if (auto obj = std::get_if<Object>(&value)) {
+        return *obj;
+    }
+    throw JsonError("JSON value is not an object");
+}
+
+const Json& Json::operator[](std::string_view key) const {
+    static const Json null;
+    for (const auto& [name, member] : asObject()) {
+        if (name == key) {
+            return member;
+        }
+    }
+    return null;
+}
+
+std::string Json::toString() const {
+    if (isString()) {
+        return asString();
+    }
+    if (isNumber()) {
+        double num{asNumber()};
+        if (std::trunc(num) == num && std::abs(num) < 1e15) {
+            return std::to_string(static_cast<long long>(num));
+        }
+        std::ostringstream out;
+        out << std::setprecision(17) << num;
+        return out.str();
+    }
+    if (auto b = std::get_if<bool>(&value)) {
+        return *b ? "true" : "false";
+    }
+    return isNull() ? "null" : "";
+}
@@ -0,0 +1,55 @@
+#ifndef JSON_H
+#define JSON_H
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+class JsonError : public std::runtime_error
+{
+public:
+    JsonError(const std::string& msg) :
+        std::runtime_error(msg)
+    {}
+};
+
+/*! A parsed JSON value.
+ *
+ * This is only as much JSON as autoproject needs to read StackExchange
+ * API responses and browser messages: values can be parsed, inspected
+ * and, for strings, quoted for output.
+ */
+class Json {
+public:
+    using Array = std::vector<Json>;
+    using Object = std::vector<std::pair<std::string, Json>>;
+
+    Json() = default;
+    /// parse a complete JSON text; throws JsonError if it is malformed
+    static Json parse(std::string_view text);
+    /// return `str` as a quoted and escaped JSON string
+    static std::string quote(std::string_view str);
+
+    bool isNull() const { return std::holds_alternative<std::nullptr_t>(value); }
+    bool isString() const { return std::holds_alternative<std::string>(value); }
+    bool isNumber() const { return std::holds_alternative<double>(value); }
+    bool isArray() const { return std::holds_alternative<Array>(value); }
+    bool isObject() const { return std::holds_alternative<Object>(value); }
+    /// these throw JsonError if the value is of some other type
+    const std::string& asString() const;
+    double asNumber() const;
+    bool asBool() const;
+    const Array& asArray() const;
+    const Object& asObject() const;
+    /// the named member of an object, or null if there is no such member
+    const Json& operator[](std::string_view key) const;
+    /// the value as text: strings unquoted, integral numbers without a fraction
+    std::string toString() const;
+
+private:
+    class Parser;
+    std::variant<std::nullptr_t, bool, double, std::string, Array, Object> value;
+};
+#endif // JSON_H
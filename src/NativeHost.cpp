@@ -0,0 +1,212 @@
+#include "NativeHost.h"
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory_resource>
+#include <sstream>
+#include <vector>
+
+using namespace std::literals;
+
+// refuse anything larger, rather than trying to allocate it
+static constexpr std::uint32_t maxMessageLength{64 * 1024 * 1024};
+// per-message arena for the extraction state
+static constexpr std::size_t arenaSize{256 * 1024};
+
+std::optional<std::string> readNativeMessage(std::istream& in) {
+    char rawLength[sizeof(std::uint32_t)];
+    if (!in.read(rawLength, sizeof rawLength)) {
+        if (in.gcount() == 0) {
+            return std::nullopt;
+        }
+        throw std::runtime_error("truncated message length");
+    }
+    std::uint32_t length;
+    std::memcpy(&length, rawLength, sizeof length);
+    if (length > maxMessageLength) {
+        throw std::runtime_error("message of " + std::to_string(length) + " bytes is too long");
+    }
+    std::string message(length, '\0');
+    if (!in.read(message.data(), length)) {
+        throw std::runtime_error("truncated message");
+    }
+    return message;
+}
+
+void writeNativeMessage(std::ostream& out, std::string_view json) {
+    const auto length{static_cast<std::uint32_t>(json.size())};
+    char rawLength[sizeof length];
+    std::memcpy(rawLength, &length, sizeof length);
+    out.write(rawLength, sizeof rawLength);
+    out.write(json.data(), static_cast<std::streamsize>(json.size()));
+    out.flush();
+}
+
+static void appendUtf8(std::string& out, unsigned long code) {
+    if (code < 0x80) {
+        out.push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+        out.push_back(static_cast<char>(0xc0 | (code >> 6)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+    } else if (code < 0x10000) {
+        out.push_back(static_cast<char>(0xe0 | (code >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+    } else {
+        out.push_back(static_cast<char>(0xf0 | (code >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+    }
+}
+
+/*
+ * Handles numeric references and the named entities that StackExchange 
+ * actually emits; anything else is left as it is.
+ */
+std::string htmlUnescape(std::string_view text) {
+    static constexpr std::array<std::pair<std::string_view, std::string_view>, 6> entities{{
+        {"amp", "&"}, {"lt", "<"}, {"gt", ">"}, {"quot", "\""}, {"apos", "'"}, {"nbsp", " "},
+    }};
+    std::string result;
+    result.reserve(text.size());
+    for (std::size_t pos{0}; pos < text.size(); ) {
+        auto amp{text.find('&', pos)};
+        result.append(text.substr(pos, amp - pos));
+        if (amp == std::string_view::npos) {
+            break;
+        }
+        pos = amp + 1;
+        auto semi{text.find(';', pos)};
+        bool replaced{false};
+        if (semi != std::string_view::npos && semi - pos <= 10) {
+            auto name{text.substr(pos, semi - pos)};
+            if (name.starts_with('#') && name.size() > 1) {
+                bool hex{name[1] == 'x' || name[1] == 'X'};
+                auto digits{name.substr(hex ? 2 : 1)};
+                unsigned long code{0};
+                auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), code, hex ? 16 : 10);
+                if (ec == std::errc{} && end == digits.data() + digits.size() && !digits.empty() && code <= 0x10ffff) {
+                    appendUtf8(result, code);
+                    replaced = true;
+                }
+            } else {
+                for (const auto& [entity, replacement] : entities) {
+                    if (name == entity) {
+                        result.append(replacement);
+                        replaced = true;
+                        break;
+                    }
+                }
+            }
+        }
+        if (replaced) {
+            pos = semi + 1;
+        } else {
+            result.push_back('&');
+        }
+    }
+    return result;
+}
+
+std::string questionMarkdown(const Json& question) {
+    const auto qnumber{question["question_id"].toString()};
+    // tags are written as a Python list, just as fetchQ does
+    std::string tags{"["};
+    for (const auto& tag : question["tags"].asArray()) {
+        if (tags.size() > 1) {
+            tags += ", ";
+        }
+        tags += "'" + tag.asString() + "'";
+    }
+    tags += "]";
+    std::string md{"# [" + htmlUnescape(question["title"].asString()) + "](https://codereview.stackexchange.com/questions/" + qnumber + ")\n"
+        "### tags: " + tags + "\n\n"};
+    const auto body{htmlUnescape(question["body_markdown"].asString())};
+    for (std::size_t pos{0}; pos < body.size(); ) {
+        auto crlf{body.find("\r\n", pos)};
+        md.append(body, pos, crlf - pos);
+        if (crlf == std::string::npos) {
+            break;
+        }
+        md.push_back('\n');
+        pos = crlf + 2;
+    }
+    return md;
+}
+
+NativeHost::NativeHost(std::istream& in, std::ostream& out, std::shared_ptr<ConfigStore> config, 
+        fs::path basedir, bool overwrite) :
+    in{in},
+    out{out},
+    config{std::move(config)},
+    basedir{basedir},
+    overwrite{overwrite}
+{
+}
+
+std::size_t NativeHost::run() {
+    try {
+        while (auto message = readNativeMessage(in)) {
+            writeNativeMessage(out, handle(*message));
+        }
+    }
+    catch(const std::exception& e) {
+        // the input stream can't be trusted after this, so stop
+        writeNativeMessage(out, R"({"status":"error","message":)" + Json::quote(e.what()) + "}");
+    }
+    return projects;
+}
+
+std::string NativeHost::handle(const std::string& message) {
+    std::string qnumber;
+    std::stringstream status;
+    std::string result{"error"};
+    std::string detail;
+    try {
+        // a bad new configuration is reported, but the old one still works
+        config->refresh();
+    }
+    catch(const std::exception& e) {
+        std::cerr << "Error: cannot reload the configuration: " << e.what() << '\n';
+    }
+    try {
+        const auto question{Json::parse(message)};
+        qnumber = question["question_id"].toString();
+        if (qnumber.empty() || qnumber.find_first_not_of("0123456789") != std::string::npos) {
+            throw std::runtime_error("message has no valid question_id");
+        }
+        const fs::path mdfile{basedir / (qnumber + ".md")};
+        {
+            std::ofstream md{mdfile, std::ios::binary};
+            md << questionMarkdown(question);
+            if (!md) {
+                throw std::runtime_error("cannot write "s + mdfile.string());
+            }
+        }
+        std::vector<std::byte> buffer(arenaSize);
+        std::pmr::monotonic_buffer_resource arena{buffer.data(), buffer.size()};
+        AutoProject ap{mdfile, config->current(), &arena};
+        if (ap.createProject(overwrite)) {
+            status << ap;
+            result = "ok";
+            ++projects;
+        } else {
+            status << "No source files found in " << mdfile;
+            result = "empty";
+        }
+    }
+    catch(const LimitExceeded& e) {
+        status << "Error: " << e.what();
+        result = "limit";
+        detail = ",\"limit\":{\"name\":" + Json::quote(e.limit()) + ",\"allowed\":" + std::to_string(e.allowed())
+            + ",\"actual\":" + std::to_string(e.actual()) + ",\"line\":" + std::to_string(e.line()) + "}";
+    }
+    catch(const std::exception& e) {
+        status << "Error: " << e.what();
+    }
+    return "{\"question_id\":" + (qnumber.empty() ? "null"s : qnumber) 
+        + ",\"status\":\"" + result + "\",\"message\":" + Json::quote(status.str()) + detail + "}";
+}
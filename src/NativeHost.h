@@ -0,0 +1,61 @@
+#ifndef NATIVEHOST_H
+#define NATIVEHOST_H
+#include "AutoProject.h"
+#include "ConfigSnapshot.h"
+#include "Json.h"
+#include <cstddef>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace fs = std::filesystem;
+
+/// the ID of the browser extension which talks to this host
+inline constexpr std::string_view extensionId{"autoproject@beroset.com"};
+
+/*! read one native messaging message: a 32-bit length in native byte
+ * order followed by that many bytes of UTF-8 JSON.
+ *
+ * Returns nothing at end of input and throws on a truncated message.
+ */
+std::optional<std::string> readNativeMessage(std::istream& in);
+/// write `json` as one native messaging message and flush it
+void writeNativeMessage(std::ostream& out, std::string_view json);
+/// replace the HTML character references which StackExchange uses in markdown
+std::string htmlUnescape(std::string_view text);
+/*! build the contents of a .md file from a StackExchange question,
+ * with the same title and tags header that `fetchQ` writes.
+ */
+std::string questionMarkdown(const Json& question);
+
+/*! Speaks the browser's native messaging protocol on behalf of the
+ * autodownload extension.
+ *
+ * Each message is a StackExchange question which is written to 
+ * `basedir/<question_id>.md` and extracted in-process.  One reply, a 
+ * JSON object with the outcome, is sent back for each message.  A
+ * question which exceeds the extraction limits gets the status "limit"
+ * and a "limit" object naming the setting and the amounts.  Before each
+ * message, the configuration is reloaded if its files have changed.
+ */
+class NativeHost {
+public:
+    NativeHost(std::istream& in, std::ostream& out, std::shared_ptr<ConfigStore> config, 
+            fs::path basedir, bool overwrite);
+    /// handle messages until end of input; returns the number of projects created
+    std::size_t run();
+
+private:
+    std::string handle(const std::string& message);
+
+    std::istream& in;
+    std::ostream& out;
+    std::shared_ptr<ConfigStore> config;
+    fs::path basedir;
+    bool overwrite;
+    std::size_t projects{0};
+};
+#endif // NATIVEHOST_H
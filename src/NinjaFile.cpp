@@ -0,0 +1,63 @@
+#include "NinjaFile.h"
+#include <sstream>
+
+std::string ninjaEscape(std::string_view path) {
+    std::string escaped;
+    for (auto ch : path) {
+        if (ch == '$' || ch == ' ' || ch == ':') {
+            escaped.push_back('$');
+        }
+        escaped.push_back(ch);
+    }
+    return escaped;
+}
+
+void writeNinjaFile(std::ostream& out, const BuildInfo& project) {
+    std::string libs;
+    std::string unresolved;
+    for (const auto& libraries : project.libraries) {
+        std::istringstream in{libraries};
+        for (std::string lib; in >> lib; ) {
+            if (lib.find('$') != std::string::npos || lib.find("::") != std::string::npos) {
+                unresolved.append(" ").append(lib);
+            } else {
+                libs.append(" ").append(lib.starts_with('-') ? "" : "-l").append(lib);
+            }
+        }
+    }
+    const auto srcdir{project.srcdir.filename().string()};
+    out << "# build.ninja for " << project.projname << ", written by autoproject\n"
+        << "launcher = " << project.launcher << '\n'
+        << "compiler = " << project.compiler << '\n'
+        << "flags = " << project.flags << '\n'
+        << "linker = " << project.linker << '\n'
+        << "linkflags = " << project.linkflags << '\n'
+        << "libs =" << libs << '\n';
+    if (!unresolved.empty()) {
+        out << "# left to CMake:" << unresolved << '\n';
+    }
+    out << "\nrule compile\n";
+    if (project.lang == "asm") {
+        // nasm has no -c and takes a separator on the include directory
+        out << "  command = $launcher $compiler $flags -I " << srcdir << "/ -MD $out.d -o $out $in\n";
+    } else {
+        out << "  command = $launcher $compiler $flags -I " << srcdir << " -MD -MF $out.d -c $in -o $out\n";
+    }
+    out << "  depfile = $out.d\n"
+        << "  deps = gcc\n"
+        << "  description = Compiling $in\n"
+        << "\nrule link\n"
+        << "  command = $linker $linkflags $in -o $out $libs\n"
+        << "  description = Linking $out\n\n";
+    std::string objects;
+    for (const auto& source : project.sources) {
+        if (isTranslationUnit(source)) {
+            const auto object{"build/" + ninjaEscape(source.filename().string()) + ".o"};
+            out << "build " << object << ": compile " << srcdir << '/' << ninjaEscape(source.filename().string()) << '\n';
+            objects.append(" ").append(object);
+        }
+    }
+    const auto target{"build/" + ninjaEscape(project.projname)};
+    out << "build " << target << ": link" << objects << '\n'
+        << "\ndefault " << target << '\n';
+}
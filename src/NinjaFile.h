@@ -0,0 +1,19 @@
+#ifndef NINJAFILE_H
+#define NINJAFILE_H
+#include "AutoProject.h"
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/// escape the characters which are special in ninja paths
+std::string ninjaEscape(std::string_view path);
+
+/*! write a `build.ninja` which builds `project` with no configure step.
+ *
+ * Paths are relative to the project's output directory.  The objects and
+ * the executable go in its `build` subdirectory, just as CMake's would.
+ * Libraries which only CMake can resolve, such as `${SDL2_LIBRARIES}`,
+ * are left out; the rules' link flags are expected to cover them.
+ */
+void writeNinjaFile(std::ostream& out, const BuildInfo& project);
+#endif // NINJAFILE_H
@@ -0,0 +1,371 @@
+#include <config.h>
+#include "OutputWriter.h"
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <initializer_list>
+#include <map>
+#include <system_error>
+#ifdef HAVE_LINUX_IO_URING_H
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+void OutputBatch::directory(const fs::path& dir) {
+    dirs.push_back(dir);
+}
+
+std::string& OutputBatch::file(const fs::path& filename) {
+    auto [it, added]{index.try_emplace(filename.string(), outfiles.size())};
+    if (added) {
+        outfiles.push_back({filename, {}});
+    }
+    auto& contents{outfiles[it->second].contents};
+    contents.clear();
+    return contents;
+}
+
+void OutputBatch::append(OutputBatch&& other) {
+    for (auto& dir : other.dirs) {
+        dirs.push_back(std::move(dir));
+    }
+    for (auto& outfile : other.outfiles) {
+        file(outfile.path) = std::move(outfile.contents);
+    }
+    other.clear();
+}
+
+std::size_t OutputBatch::bytes() const {
+    std::size_t total{0};
+    for (const auto& outfile : outfiles) {
+        total += outfile.contents.size();
+    }
+    return total;
+}
+
+void OutputBatch::clear() {
+    dirs.clear();
+    outfiles.clear();
+    index.clear();
+}
+
+namespace {
+// one blocking call per directory and per file
+class SyncWriter final : public OutputWriter {
+public:
+    void write(const OutputBatch& batch) override {
+        for (const auto& dir : batch.directories()) {
+            fs::create_directories(dir);
+        }
+        // the first failure is thrown once the other files are written
+        std::error_code firstError;
+        fs::path failed;
+        for (const auto& outfile : batch.files()) {
+            errno = 0;
+            std::ofstream out{outfile.path, std::ios::binary};
+            out.write(outfile.contents.data(), static_cast<std::streamsize>(outfile.contents.size()));
+            out.close();
+            if (!out && !firstError) {
+                firstError.assign(errno ? errno : EIO, std::generic_category());
+                failed = outfile.path;
+            }
+        }
+        if (firstError) {
+            throw std::system_error(firstError, "Cannot write " + failed.string());
+        }
+    }
+    std::string_view name() const override { return "sync"; }
+};
+
+#ifdef HAVE_LINUX_IO_URING_H
+/*
+ * Submits the work for a whole batch as rounds of independent io_uring
+ * operations: the directories one depth at a time, then for each group
+ * of files, all of the opens, all of the writes and all of the closes.
+ * liburing is not needed; the ring is set up with the raw system calls.
+ */
+class UringWriter final : public OutputWriter {
+public:
+    static constexpr unsigned ringEntries{256};
+
+    static std::unique_ptr<OutputWriter> create() {
+        std::unique_ptr<UringWriter> writer{new UringWriter};
+        return writer->setup() ? std::move(writer) : nullptr;
+    }
+    UringWriter(const UringWriter&) = delete;
+    UringWriter& operator=(const UringWriter&) = delete;
+    ~UringWriter() override {
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, sqesSize);
+        }
+        if (ring != MAP_FAILED) {
+            munmap(ring, ringSize);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    void write(const OutputBatch& batch) override {
+        makeDirectories(batch.directories());
+        const auto& files{batch.files()};
+        std::error_code firstError;
+        fs::path failed;
+        auto fail = [&](int error, const fs::path& path) {
+            if (!firstError) {
+                firstError.assign(error, std::generic_category());
+                failed = path;
+            }
+        };
+        for (std::size_t first{0}; first < files.size(); first += ringEntries) {
+            const auto count{std::min<std::size_t>(ringEntries, files.size() - first)};
+            auto fds{execute(count, [&](io_uring_sqe& sqe, std::size_t i) {
+                sqe.opcode = IORING_OP_OPENAT;
+                sqe.fd = AT_FDCWD;
+                sqe.addr = reinterpret_cast<std::uintptr_t>(files[first + i].path.c_str());
+                sqe.len = 0666;
+                sqe.open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+            })};
+            std::vector<std::size_t> open;
+            for (std::size_t i{0}; i < count; ++i) {
+                if (fds[i] < 0) {
+                    fail(-fds[i], files[first + i].path);
+                } else {
+                    open.push_back(i);
+                }
+            }
+            std::vector<int> written;
+            try {
+                written = execute(open.size(), [&](io_uring_sqe& sqe, std::size_t i) {
+                    const auto& contents{files[first + open[i]].contents};
+                    sqe.opcode = IORING_OP_WRITE;
+                    sqe.fd = fds[open[i]];
+                    sqe.addr = reinterpret_cast<std::uintptr_t>(contents.data());
+                    sqe.len = static_cast<unsigned>(std::min<std::size_t>(contents.size(), maxWrite));
+                    sqe.off = 0;
+                });
+            }
+            catch (...) {
+                // none of the closes has been submitted, so the files are closed here
+                for (auto i : open) {
+                    close(fds[i]);
+                }
+                throw;
+            }
+            for (std::size_t i{0}; i < open.size(); ++i) {
+                const auto& outfile{files[first + open[i]]};
+                if (written[i] < 0) {
+                    fail(-written[i], outfile.path);
+                } else if (!finishWrite(fds[open[i]], outfile.contents, static_cast<std::size_t>(written[i]))) {
+                    fail(errno, outfile.path);
+                }
+            }
+            auto closed{execute(open.size(), [&](io_uring_sqe& sqe, std::size_t i) {
+                sqe.opcode = IORING_OP_CLOSE;
+                sqe.fd = fds[open[i]];
+            })};
+            for (std::size_t i{0}; i < open.size(); ++i) {
+                if (closed[i] < 0) {
+                    fail(-closed[i], files[first + open[i]].path);
+                }
+            }
+        }
+        if (firstError) {
+            throw std::system_error(firstError, "Cannot write " + failed.string());
+        }
+    }
+    std::string_view name() const override { return "io_uring"; }
+
+private:
+    // a single write is at most this long; the rest is written synchronously
+    static constexpr std::size_t maxWrite{1u << 30};
+
+    UringWriter() = default;
+
+    /*
+     * true if the kernel has every one of `ops`.  Before 5.6 there was
+     * neither the probe nor opening and closing files through the ring, so
+     * a ring can be set up whose every file operation fails with EINVAL.
+     */
+    bool supported(std::initializer_list<unsigned> ops) const {
+        static constexpr unsigned probeOps{256};
+        alignas(io_uring_probe) std::byte buffer[sizeof(io_uring_probe) + probeOps * sizeof(io_uring_probe_op)]{};
+        auto *probe{reinterpret_cast<io_uring_probe *>(buffer)};
+        if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, probeOps) < 0) {
+            return false;
+        }
+        return std::all_of(ops.begin(), ops.end(), [probe](unsigned op) {
+            return op < probe->ops_len && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+        });
+    }
+
+    bool setup() {
+        io_uring_params params{};
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, ringEntries, &params));
+        if (fd < 0 || !(params.features & IORING_FEAT_SINGLE_MMAP)) {
+            return false;
+        }
+        if (!supported({IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_CLOSE})) {
+            return false;
+        }
+        ringSize = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+        ring = mmap(nullptr, ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (ring == MAP_FAILED) {
+            return false;
+        }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void *sqeMap{mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES)};
+        if (sqeMap == MAP_FAILED) {
+            return false;
+        }
+        sqes = static_cast<io_uring_sqe *>(sqeMap);
+        auto at = [this](unsigned offset) {
+            return reinterpret_cast<unsigned *>(static_cast<char *>(ring) + offset);
+        };
+        sqTail = at(params.sq_off.tail);
+        sqMask = *at(params.sq_off.ring_mask);
+        sqArray = at(params.sq_off.array);
+        cqHead = at(params.cq_off.head);
+        cqTail = at(params.cq_off.tail);
+        cqMask = *at(params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe *>(static_cast<char *>(ring) + params.cq_off.cqes);
+        sqEntries = params.sq_entries;
+        return true;
+    }
+
+    int enter(unsigned toSubmit, unsigned minComplete) {
+        for (;;) {
+            auto result{syscall(__NR_io_uring_enter, fd, toSubmit, minComplete,
+                    minComplete ? IORING_ENTER_GETEVENTS : 0, nullptr, 0)};
+            if (result >= 0) {
+                return static_cast<int>(result);
+            }
+            if (errno != EINTR) {
+                throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+            }
+        }
+    }
+
+    /*
+     * Run `count` independent operations, `prepare` filling in the
+     * submission for each, and return the result of each.
+     */
+    template <typename Prepare>
+    std::vector<int> execute(std::size_t count, Prepare prepare) {
+        std::vector<int> results(count);
+        for (std::size_t first{0}; first < count; ) {
+            const auto batch{static_cast<unsigned>(std::min<std::size_t>(sqEntries, count - first))};
+            const unsigned tail{*sqTail};
+            for (unsigned i{0}; i < batch; ++i) {
+                const unsigned slot{(tail + i) & sqMask};
+                io_uring_sqe& sqe{sqes[slot]};
+                std::memset(&sqe, 0, sizeof sqe);
+                prepare(sqe, first + i);
+                sqe.user_data = first + i;
+                sqArray[slot] = slot;
+            }
+            std::atomic_ref<unsigned>{*sqTail}.store(tail + batch, std::memory_order_release);
+            for (unsigned submitted{0}; submitted < batch; ) {
+                submitted += static_cast<unsigned>(enter(batch - submitted, 0));
+            }
+            for (unsigned done{0}; done < batch; ) {
+                unsigned head{*cqHead};
+                const unsigned available{std::atomic_ref<unsigned>{*cqTail}.load(std::memory_order_acquire)};
+                if (head == available) {
+                    enter(0, 1);
+                    continue;
+                }
+                for ( ; head != available; ++head, ++done) {
+                    const auto& cqe{cqes[head & cqMask]};
+                    results[cqe.user_data] = cqe.res;
+                }
+                std::atomic_ref<unsigned>{*cqHead}.store(head, std::memory_order_release);
+            }
+            first += batch;
+        }
+        return results;
+    }
+
+    // create the directories and their parents, shallowest first
+    void makeDirectories(const std::vector<fs::path>& dirs) {
+        std::map<std::size_t, std::vector<std::string>> byDepth;
+        std::vector<fs::path> all;
+        for (const auto& dir : dirs) {
+            for (auto path{dir.lexically_normal()}; path.has_relative_path(); path = path.parent_path()) {
+                if (path.filename().empty()) {
+                    continue;
+                }
+                all.push_back(path);
+            }
+        }
+        std::sort(all.begin(), all.end());
+        all.erase(std::unique(all.begin(), all.end()), all.end());
+        for (const auto& path : all) {
+            byDepth[static_cast<std::size_t>(std::distance(path.begin(), path.end()))].push_back(path.string());
+        }
+        for (const auto& [depth, paths] : byDepth) {
+            auto results{execute(paths.size(), [&](io_uring_sqe& sqe, std::size_t i) {
+                sqe.opcode = IORING_OP_MKDIRAT;
+                sqe.fd = AT_FDCWD;
+                sqe.addr = reinterpret_cast<std::uintptr_t>(paths[i].c_str());
+                sqe.len = 0777;
+            })};
+            for (std::size_t i{0}; i < paths.size(); ++i) {
+                // older kernels lack mkdirat, so anything unexpected is retried
+                if (results[i] < 0 && results[i] != -EEXIST) {
+                    fs::create_directories(paths[i]);
+                }
+            }
+        }
+    }
+
+    // write whatever the first write left over
+    static bool finishWrite(int fd, const std::string& contents, std::size_t done) {
+        while (done < contents.size()) {
+            auto n{pwrite(fd, contents.data() + done, contents.size() - done, static_cast<off_t>(done))};
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            done += static_cast<std::size_t>(n);
+        }
+        return true;
+    }
+
+    int fd{-1};
+    void *ring{MAP_FAILED};
+    std::size_t ringSize{0};
+    io_uring_sqe *sqes{static_cast<io_uring_sqe *>(MAP_FAILED)};
+    std::size_t sqesSize{0};
+    unsigned *sqTail{nullptr};
+    unsigned sqMask{0};
+    unsigned *sqArray{nullptr};
+    unsigned *cqHead{nullptr};
+    unsigned *cqTail{nullptr};
+    unsigned cqMask{0};
+    io_uring_cqe *cqes{nullptr};
+    unsigned sqEntries{0};
+};
+#endif
+}
+
+std::unique_ptr<OutputWriter> OutputWriter::create([[maybe_unused]] bool async) {
+#ifdef HAVE_LINUX_IO_URING_H
+    if (async) {
+        if (auto writer{UringWriter::create()}) {
+            return writer;
+        }
+    }
+#endif
+    return std::make_unique<SyncWriter>();
+}
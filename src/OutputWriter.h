@@ -0,0 +1,73 @@
+#ifndef OUTPUTWRITER_H
+#define OUTPUTWRITER_H
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/// one file to be written
+struct OutputFile {
+    fs::path path;
+    std::string contents;
+};
+
+/*! Directories and files to be created, collected in memory.
+ *
+ * Extracting into a batch rather than straight to disk lets the files of
+ * many projects be written together by an `OutputWriter`.
+ */
+class OutputBatch {
+public:
+    /// create `dir` and any missing parents
+    void directory(const fs::path& dir);
+    /*! the contents of `filename`, which are emptied if it was already in
+     * the batch, just as opening a file for writing truncates it.
+     *
+     * The reference stays valid until the batch is cleared.
+     */
+    std::string& file(const fs::path& filename);
+    /// move everything from `other` to the end of this batch
+    void append(OutputBatch&& other);
+    const std::vector<fs::path>& directories() const { return dirs; }
+    const std::deque<OutputFile>& files() const { return outfiles; }
+    /// the total size of the file contents
+    std::size_t bytes() const;
+    bool empty() const { return dirs.empty() && outfiles.empty(); }
+    void clear();
+
+private:
+    std::vector<fs::path> dirs;
+    // a deque, so that references to the contents are never invalidated
+    std::deque<OutputFile> outfiles;
+    std::unordered_map<std::string, std::size_t> index;
+};
+
+/*! Writes batches of files to disk.
+ *
+ * Directories are created first, then the files are written.  A
+ * directory which can't be created throws `fs::filesystem_error` at
+ * once; the first file which can't be written throws `std::system_error`
+ * once the rest of the batch has been written.
+ */
+class OutputWriter {
+public:
+    virtual ~OutputWriter() = default;
+    virtual void write(const OutputBatch& batch) = 0;
+    /// the name of the backend, for diagnostics
+    virtual std::string_view name() const = 0;
+    /*! create a writer.
+     *
+     * If `async` is set and the kernel supports it, the directories and
+     * files are created with batched io_uring operations.  Otherwise, or
+     * if io_uring is unavailable, `std::filesystem` and `std::ofstream`
+     * are used as when extracting a single project.
+     */
+    static std::unique_ptr<OutputWriter> create(bool async = true);
+};
+#endif // OUTPUTWRITER_H
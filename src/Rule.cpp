@@ -0,0 +1,59 @@
+#include "Rule.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+const std::regex Rule::newline{R"(\\n)"};
+
+RuleSet compileRules(std::span<const RuleFields> fields, std::string_view origin) {
+    RuleSet rules;
+    rules.reserve(fields.size());
+    for (const auto& field : fields) {
+        const auto scope{parseRuleScope(field.scope)};
+        if (!scope) {
+            std::cerr << "Error: unknown scope \"" << field.scope << "\" in line " << field.line
+                << " of rules file " << origin << "\n";
+            continue;
+        }
+        try {
+            rules.emplace_back(std::string{field.regex}, std::string{field.cmake}, 
+                    std::string{field.libraries}, std::string{field.flags}, 
+                    std::string{field.linkflags}, *scope);
+        } 
+        catch (const std::regex_error& e) {
+            std::cerr << "Error: " << e.what() << " in line " << field.line << " of rules file " << origin << "\n";
+            std::cout << "regex = \"" << field.regex << "\"\n"
+                << "cmake lines = \"" << field.cmake << "\"\n"
+                << "libraries = \"" << field.libraries << "\"\n"
+                << "flags = \"" << field.flags << "\"\n"
+                << "link flags = \"" << field.linkflags << "\"\n"
+                << "scope = \"" << field.scope << "\"\n";
+        }
+    }
+    std::cout << "Loaded " << rules.size() << " rules\n";
+    return rules;
+}
+
+RuleSet readRules(const fs::path &rulesfile) {
+    std::ifstream in(rulesfile);
+    if (!in) {
+        throw std::runtime_error("cannot open rules file \"" + rulesfile.string() + "\"");
+    }
+    std::stringstream text;
+    text << in.rdbuf();
+    const std::string contents{text.str()};
+    std::vector<RuleFields> fields;
+    forEachRule(contents, [&fields](const RuleFields& f){ fields.push_back(f); });
+    return compileRules(fields, rulesfile.string());
+}
+
+RuleSet loadrules(const fs::path &rulesfile) {
+    try {
+        return readRules(rulesfile);
+    }
+    catch (const std::runtime_error&) {
+        std::cerr << "Unable to open rules file: " << rulesfile << "\n";
+        return {};
+    }
+}
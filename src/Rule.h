@@ -0,0 +1,155 @@
+#ifndef RULE_H
+#define RULE_H
+#include "SourceTokenizer.h"
+#include <array>
+#include <filesystem>
+#include <optional>
+#include <regex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/// which lines of source a rule is matched against
+enum class RuleScope {
+    any,        // every line, as written
+    code,       // every line, with its comments removed
+    directive,  // only preprocessor directives, with their comments removed
+};
+
+/// the scope named in a rules file, where empty means `any`, or nothing if there is no such scope
+constexpr std::optional<RuleScope> parseRuleScope(std::string_view name) {
+    if (name.empty() || name == "any") {
+        return RuleScope::any;
+    }
+    if (name == "code") {
+        return RuleScope::code;
+    }
+    if (name == "directive") {
+        return RuleScope::directive;
+    }
+    return std::nullopt;
+}
+
+/*! A single line from a rules file.
+ *
+ * If `re` matches a line of extracted source within its `scope`, `cmake`
+ * is added to the source level CMake file and `libraries` to the link 
+ * line.  `flags` and `linkflags` are extra compiler and linker flags for
+ * when the sources are built without CMake.
+ */
+struct Rule {
+    // the regular expression as written in the rules file
+    const std::string pattern;
+    const std::regex re;
+    const std::string cmake;
+    const std::string libraries;
+    const std::string flags;
+    const std::string linkflags;
+    const RuleScope scope;
+    static const std::regex newline;
+    Rule(std::string reg, std::string result, std::string libraries, 
+            std::string flags = {}, std::string linkflags = {}, RuleScope scope = RuleScope::any) : 
+        pattern{reg}, re{pattern}, 
+        cmake{std::regex_replace(result, newline, "\n")},
+        libraries{libraries},
+        flags{flags},
+        linkflags{linkflags},
+        scope{scope} {
+    }
+    /// true if the rule is matched against `line` at all
+    bool appliesTo(const SourceLine& line) const {
+        return scope != RuleScope::directive || line.directive;
+    }
+    /// true if the rule applies to `line` and matches it
+    bool matches(const SourceLine& line) const {
+        if (!appliesTo(line)) {
+            return false;
+        }
+        const auto text{scope == RuleScope::any ? line.text : line.code};
+        return std::regex_search(text.begin(), text.end(), re);
+    }
+};
+
+using RuleSet = std::vector<Rule>;
+
+/// the '@' separated fields of a rules file line, not yet compiled
+struct RuleFields {
+    std::string_view regex{};
+    std::string_view cmake{};
+    std::string_view libraries{};
+    std::string_view flags{};
+    std::string_view linkflags{};
+    std::string_view scope{};
+    // the line of the rules file the fields came from, counting from 1
+    std::size_t line{0};
+};
+
+/*! split one line of a rules file into its fields.
+ *
+ * Equivalent to matching `([^@]+)@([^@]*)@([^@]*)(@([^@]*)(@([^@]*)(@(.*))?)?)?`
+ * against the line, so comments and other lines without at least two 
+ * separators yield nothing.
+ */
+constexpr std::optional<RuleFields> splitRule(std::string_view line) {
+    auto first{line.find('@')};
+    if (first == 0 || first == std::string_view::npos) {
+        return std::nullopt;
+    }
+    auto second{line.find('@', first + 1)};
+    if (second == std::string_view::npos) {
+        return std::nullopt;
+    }
+    RuleFields fields{line.substr(0, first), line.substr(first + 1, second - first - 1)};
+    // the optional fields; the last takes the rest of the line
+    auto rest{line.substr(second + 1)};
+    for (auto field : {&fields.libraries, &fields.flags, &fields.linkflags}) {
+        auto at{rest.find('@')};
+        *field = rest.substr(0, at);
+        if (at == std::string_view::npos) {
+            return fields;
+        }
+        rest.remove_prefix(at + 1);
+    }
+    fields.scope = rest;
+    return fields;
+}
+
+/// call `f` with the fields of each rule in the text of a rules file
+template <typename F>
+constexpr void forEachRule(std::string_view text, F&& f) {
+    for (std::size_t number{1}; !text.empty(); ++number) {
+        auto eol{text.find('\n')};
+        auto line{text.substr(0, eol)};
+        if (auto fields{splitRule(line)}) {
+            fields->line = number;
+            f(*fields);
+        }
+        text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 1);
+    }
+}
+
+constexpr std::size_t countRules(std::string_view text) {
+    std::size_t count{0};
+    forEachRule(text, [&count](const RuleFields&){ ++count; });
+    return count;
+}
+
+/// split a whole rules file at compile time
+template <std::size_t N>
+constexpr std::array<RuleFields, N> splitRules(std::string_view text) {
+    std::array<RuleFields, N> rules{};
+    std::size_t i{0};
+    forEachRule(text, [&](const RuleFields& fields){ rules[i++] = fields; });
+    return rules;
+}
+
+/// compile already split rules; `origin` names their source in error messages
+RuleSet compileRules(std::span<const RuleFields> fields, std::string_view origin);
+/// load and compile all of the rules in the named rules file, throwing if it can't be read
+RuleSet readRules(const fs::path& rulesfile);
+/// as `readRules`, but report a file that can't be read and return no rules
+RuleSet loadrules(const fs::path& rulesfile);
+#endif // RULE_H
@@ -0,0 +1,207 @@
+#include "RuleProfiler.h"
+#include "Json.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <iomanip>
+#include <regex>
+
+RuleProfiler::RuleProfiler(std::map<std::string, LangConfig>& lang) :
+    lang{&lang}
+{}
+
+// times below this many nanoseconds each have a bucket of their own
+static constexpr std::uint64_t subBuckets{16};
+
+static std::size_t bucketOf(std::uint64_t ns) {
+    if (ns < subBuckets) {
+        return ns;
+    }
+    const auto shift{static_cast<unsigned>(std::bit_width(ns) - std::bit_width(subBuckets))};
+    return (shift + 1) * subBuckets + ((ns >> shift) - subBuckets);
+}
+
+// the longest time counted in `bucket`
+static std::uint64_t bucketEnd(std::size_t bucket) {
+    if (bucket < subBuckets) {
+        return bucket;
+    }
+    const auto shift{bucket / subBuckets - 1};
+    return ((bucket % subBuckets + subBuckets + 1) << shift) - 1;
+}
+
+void RuleProfiler::Histogram::add(Duration time) {
+    const auto bucket{bucketOf(static_cast<std::uint64_t>(std::max(time.count(), Duration::rep{0})))};
+    if (bucket >= buckets.size()) {
+        buckets.resize(bucket + 1);
+    }
+    ++buckets[bucket];
+}
+
+RuleProfiler::Duration RuleProfiler::Histogram::percentile(unsigned percent) const {
+    std::size_t count{0};
+    for (auto n : buckets) {
+        count += n;
+    }
+    const auto rank{count * percent / 100};
+    std::size_t seen{0};
+    for (std::size_t bucket{0}; bucket < buckets.size(); ++bucket) {
+        seen += buckets[bucket];
+        if (seen > rank) {
+            return Duration{static_cast<Duration::rep>(bucketEnd(bucket))};
+        }
+    }
+    return Duration{0};
+}
+
+// orders a heap of slow lines with the fastest first
+static bool slower(const RuleProfiler::SlowLine& a, const RuleProfiler::SlowLine& b) {
+    return a.time > b.time;
+}
+
+void RuleProfiler::profile(const fs::path& mdfile) {
+    AutoProject ap{mdfile, *lang};
+    ap.scanCode([&](const SourceLine& line, const RuleSet *rules) {
+        if (!rules) {
+            return;
+        }
+        auto timing{timingsFor(rules)};
+        for (std::size_t i{0}; i < rules->size(); ++i) {
+            const auto& rule{(*rules)[i]};
+            if (!rule.appliesTo(line)) {
+                continue;
+            }
+            auto start{std::chrono::steady_clock::now()};
+            bool hit{rule.matches(line)};
+            const auto time{std::chrono::duration_cast<Duration>(std::chrono::steady_clock::now() - start)};
+            auto& each{timing->each[i]};
+            ++each.lines;
+            each.hits += hit;
+            each.total += time;
+            each.max = std::max(each.max, time);
+            each.times.add(time);
+            // the line is only copied if it is one of the slowest yet
+            auto& slowest{each.slowest};
+            if (time > slowMinimum && (slowest.size() < slowLimit || time > slowest.front().time)) {
+                slowest.push_back({mdfile, std::string{line.text}, time});
+                std::push_heap(slowest.begin(), slowest.end(), slower);
+                if (slowest.size() > slowLimit) {
+                    std::pop_heap(slowest.begin(), slowest.end(), slower);
+                    slowest.pop_back();
+                }
+            }
+        }
+    });
+}
+
+RuleProfiler::Timings *RuleProfiler::timingsFor(const RuleSet *rules) {
+    // the rules of a language are the same object for every project
+    for (auto& [name, config] : *lang) {
+        if (config.rules.get() == rules) {
+            auto& timing{timings[name]};
+            timing.rules = rules;
+            timing.each.resize(rules->size());
+            return &timing;
+        }
+    }
+    throw std::logic_error("rules of unknown language");
+}
+
+std::size_t RuleProfiler::profileDirectory(const fs::path& dir) {
+    std::vector<fs::path> found;
+    for (const auto& entry : fs::recursive_directory_iterator(dir)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".md") {
+            found.push_back(entry.path());
+        }
+    }
+    // so that the slow lines found are the same from run to run
+    std::sort(found.begin(), found.end());
+    for (const auto& mdfile : found) {
+        profile(mdfile);
+    }
+    return found.size();
+}
+
+std::vector<RuleProfiler::Stats> RuleProfiler::results() const {
+    std::vector<Stats> all;
+    for (const auto& [name, timing] : timings) {
+        for (std::size_t i{0}; i < timing.rules->size(); ++i) {
+            const auto& each{timing.each[i]};
+            Stats stats{name, i, (*timing.rules)[i].pattern};
+            stats.lines = each.lines;
+            stats.hits = each.hits;
+            stats.total = each.total;
+            stats.max = each.max;
+            if (each.lines) {
+                stats.median = std::min(each.times.percentile(50), each.max);
+                stats.p99 = std::min(each.times.percentile(99), each.max);
+                const auto threshold{std::max(stats.median * slowFactor, slowMinimum)};
+                auto slowest{each.slowest};
+                std::sort_heap(slowest.begin(), slowest.end(), slower);
+                for (auto& slow : slowest) {
+                    if (slow.time > threshold) {
+                        stats.slow.push_back(std::move(slow));
+                    }
+                }
+            }
+            all.push_back(std::move(stats));
+        }
+    }
+    return all;
+}
+
+static double micros(RuleProfiler::Duration d) {
+    return std::chrono::duration<double, std::micro>{d}.count();
+}
+
+void writeProfileTable(std::ostream& out, const std::vector<RuleProfiler::Stats>& stats) {
+    constexpr std::size_t patternWidth{50};
+    auto shorten = [](const std::string& text) {
+        return text.size() > patternWidth ? text.substr(0, patternWidth - 3) + "..." : text;
+    };
+    const auto flags{out.flags()};
+    out << std::left << std::setw(5) << "lang" << std::right << std::setw(5) << "rule"
+        << std::setw(10) << "lines" << std::setw(8) << "hits"
+        << std::setw(12) << "total(us)" << std::setw(10) << "p99(us)" << std::setw(10) << "max(us)"
+        << "  " << "pattern\n" << std::fixed << std::setprecision(2);
+    for (const auto& rule : stats) {
+        out << std::left << std::setw(5) << rule.lang << std::right << std::setw(5) << rule.index
+            << std::setw(10) << rule.lines << std::setw(8) << rule.hits
+            << std::setw(12) << micros(rule.total) << std::setw(10) << micros(rule.p99)
+            << std::setw(10) << micros(rule.max) << "  " << shorten(rule.pattern) << '\n';
+    }
+    for (const auto& rule : stats) {
+        for (const auto& slow : rule.slow) {
+            out << "slow: " << rule.lang << " rule " << rule.index << " took " << micros(slow.time)
+                << "us in " << slow.mdfile.filename().string() << ": " << shorten(slow.line) << '\n';
+        }
+    }
+    out.flags(flags);
+    for (const auto& rule : stats) {
+        if (rule.hits == 0) {
+            out << "never fired: " << rule.lang << " rule " << rule.index << ": " << rule.pattern << '\n';
+        }
+    }
+}
+
+void writeProfileJson(std::ostream& out, const std::vector<RuleProfiler::Stats>& stats) {
+    out << "[";
+    const char *separator{"\n"};
+    for (const auto& rule : stats) {
+        out << separator << "  {\"lang\":" << Json::quote(rule.lang) << ",\"rule\":" << rule.index
+            << ",\"pattern\":" << Json::quote(rule.pattern)
+            << ",\"lines\":" << rule.lines << ",\"hits\":" << rule.hits
+            << ",\"total_ns\":" << rule.total.count() << ",\"median_ns\":" << rule.median.count()
+            << ",\"p99_ns\":" << rule.p99.count() << ",\"max_ns\":" << rule.max.count()
+            << ",\"slow\":[";
+        const char *slowSeparator{""};
+        for (const auto& slow : rule.slow) {
+            out << slowSeparator << "{\"file\":" << Json::quote(slow.mdfile.string())
+                << ",\"line\":" << Json::quote(slow.line) << ",\"ns\":" << slow.time.count() << "}";
+            slowSeparator = ",";
+        }
+        out << "]}";
+        separator = ",\n";
+    }
+    out << "\n]\n";
+}
@@ -0,0 +1,98 @@
+#ifndef RULEPROFILER_H
+#define RULEPROFILER_H
+#include "AutoProject.h"
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/*! Measures what each rule costs over a corpus of .md files.
+ *
+ * Unlike extraction, which stops applying a rule once it has fired, the
+ * profiler applies every rule of the detected language to every line of
+ * code in its scope, so the cost of each rule is measured on all of the
+ * input.  Only running totals, a histogram of the times and the slowest
+ * few lines are kept for each rule, so memory does not grow with the
+ * size of the corpus.
+ */
+class RuleProfiler {
+public:
+    using Duration = std::chrono::nanoseconds;
+    /// a line on which one rule took abnormally long
+    struct SlowLine {
+        fs::path mdfile;
+        std::string line;
+        Duration time;
+    };
+    /// the cost of one rule of one language
+    struct Stats {
+        std::string lang;
+        std::size_t index{0};
+        std::string pattern;
+        std::size_t lines{0};
+        std::size_t hits{0};
+        Duration total{0};
+        Duration median{0};
+        Duration p99{0};
+        Duration max{0};
+        // the slowest lines, slowest first
+        std::vector<SlowLine> slow{};
+    };
+    // a line is slow if it takes this many times the rule's median...
+    static constexpr unsigned slowFactor{50};
+    // ...and at least this long
+    static constexpr Duration slowMinimum{std::chrono::microseconds{20}};
+    // at most this many slow lines are kept per rule
+    static constexpr std::size_t slowLimit{5};
+
+    explicit RuleProfiler(std::map<std::string, LangConfig>& lang);
+    /// apply the rules to the code in one .md file
+    void profile(const fs::path& mdfile);
+    /// profile every .md file in `dir` and below; returns the number of files
+    std::size_t profileDirectory(const fs::path& dir);
+    /// the statistics for every rule which was applied, by language and rule
+    std::vector<Stats> results() const;
+
+private:
+    /*! Counts durations in buckets a sixteenth of a power of two wide, so
+     * a quantile is within about 6% of the exact one however many times
+     * are added.
+     */
+    class Histogram {
+    public:
+        void add(Duration time);
+        /// the time `percent` of the way through those added, rounded up to the end of its bucket
+        Duration percentile(unsigned percent) const;
+    private:
+        std::vector<std::size_t> buckets;
+    };
+    /// the running totals for one rule
+    struct RuleTiming {
+        std::size_t lines{0};
+        std::size_t hits{0};
+        Duration total{0};
+        Duration max{0};
+        Histogram times{};
+        // the slowest lines so far, a heap with the fastest of them first
+        std::vector<SlowLine> slowest{};
+    };
+    struct Timings {
+        const RuleSet *rules;
+        // one per rule
+        std::vector<RuleTiming> each;
+    };
+    Timings *timingsFor(const RuleSet *rules);
+    std::map<std::string, LangConfig> *lang;
+    std::map<std::string, Timings> timings;
+};
+
+/// write the statistics as a table, one row per rule
+void writeProfileTable(std::ostream& out, const std::vector<RuleProfiler::Stats>& stats);
+/// write the statistics as JSON, an array with one object per rule
+void writeProfileJson(std::ostream& out, const std::vector<RuleProfiler::Stats>& stats);
+#endif // RULEPROFILER_H
@@ -0,0 +1,181 @@
+#include "ShardStatus.h"
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+
+using namespace std::literals;
+
+static constexpr std::string_view statusHeader{"# autoproject status, shard "};
+static constexpr std::string_view statusResults[]{"ok", "empty", "limit", "error"};
+
+static std::size_t parseCount(std::string_view text) {
+    std::size_t value{0};
+    auto [end, err]{std::from_chars(text.data(), text.data() + text.size(), value)};
+    if (err != std::errc{} || end != text.data() + text.size()) {
+        throw std::runtime_error("bad number \""s + std::string{text} + "\"");
+    }
+    return value;
+}
+
+Shard Shard::parse(std::string_view text) {
+    const auto slash{text.find('/')};
+    if (slash == std::string_view::npos) {
+        throw std::runtime_error("shard must be K/N, not \""s + std::string{text} + "\"");
+    }
+    Shard shard{parseCount(text.substr(0, slash)), parseCount(text.substr(slash + 1))};
+    if (shard.index < 1 || shard.index > shard.count) {
+        throw std::runtime_error("shard "s + std::string{text} + " is not between 1/N and N/N");
+    }
+    return shard;
+}
+
+bool Shard::contains(std::string_view projname) const {
+    return stableHash(projname) % count == index - 1;
+}
+
+std::string Shard::statusFilename() const {
+    return "autoproject-shard-" + std::to_string(index) + "-of-" + std::to_string(count) + ".status";
+}
+
+std::uint64_t stableHash(std::string_view text) {
+    std::uint64_t hash{14695981039346656037u};
+    for (unsigned char ch : text) {
+        hash ^= ch;
+        hash *= 1099511628211u;
+    }
+    return hash;
+}
+
+static std::string escape(std::string_view field) {
+    std::string escaped;
+    for (char ch : field) {
+        switch (ch) {
+            case '\\': escaped += "\\\\"; break;
+            case '\t': escaped += "\\t"; break;
+            case '\n': escaped += "\\n"; break;
+            default: escaped.push_back(ch);
+        }
+    }
+    return escaped;
+}
+
+static std::string unescape(std::string_view field) {
+    std::string text;
+    for (std::size_t i{0}; i < field.size(); ++i) {
+        if (field[i] == '\\' && i + 1 < field.size()) {
+            switch (field[++i]) {
+                case 't': text.push_back('\t'); break;
+                case 'n': text.push_back('\n'); break;
+                default: text.push_back(field[i]);
+            }
+        } else {
+            text.push_back(field[i]);
+        }
+    }
+    return text;
+}
+
+void writeStatus(std::ostream& out, const ShardStatus& status) {
+    out << statusHeader << status.shard.index << '/' << status.shard.count << '\n';
+    for (const auto& record : status.records) {
+        out << record.result << '\t' << escape(record.projname) << '\t' 
+            << escape(record.mdfile.string()) << '\t' << escape(record.message) << '\n';
+    }
+}
+
+ShardStatus readStatus(std::istream& in) {
+    ShardStatus status;
+    std::string line;
+    if (!std::getline(in, line) || !line.starts_with(statusHeader)) {
+        throw std::runtime_error("not an autoproject status file");
+    }
+    status.shard = Shard::parse(std::string_view{line}.substr(statusHeader.size()));
+    for (std::size_t lineno{2}; std::getline(in, line); ++lineno) {
+        std::vector<std::string_view> fields;
+        for (std::string_view rest{line}; ; ) {
+            const auto tab{rest.find('\t')};
+            fields.push_back(rest.substr(0, tab));
+            if (tab == std::string_view::npos) {
+                break;
+            }
+            rest.remove_prefix(tab + 1);
+        }
+        if (fields.size() != 4 || std::find(std::begin(statusResults), std::end(statusResults), fields[0]) == std::end(statusResults)) {
+            throw std::runtime_error("malformed record at line " + std::to_string(lineno));
+        }
+        status.records.push_back({std::string{fields[0]}, unescape(fields[1]), unescape(fields[2]), unescape(fields[3])});
+    }
+    return status;
+}
+
+int mergeStatus(std::ostream& out, std::span<const fs::path> statusfiles) {
+    std::size_t count{0};
+    // the status file of each shard, by index
+    std::map<std::size_t, fs::path> shards;
+    // the shard which extracted each project
+    std::map<std::string, std::size_t> owner;
+    std::map<std::string, std::size_t, std::less<>> totals;
+    std::vector<StatusRecord> failures;
+    std::vector<std::string> problems;
+    for (const auto& filename : statusfiles) {
+        std::ifstream in{filename};
+        if (!in) {
+            throw std::runtime_error("cannot open status file "s + filename.string());
+        }
+        ShardStatus status;
+        try {
+            status = readStatus(in);
+        }
+        catch (const std::runtime_error& e) {
+            throw std::runtime_error(filename.string() + ": " + e.what());
+        }
+        if (count == 0) {
+            count = status.shard.count;
+        } else if (status.shard.count != count) {
+            problems.push_back(filename.string() + " is from a batch of " + std::to_string(status.shard.count) 
+                    + " shards, not " + std::to_string(count));
+            continue;
+        }
+        if (auto [it, added]{shards.try_emplace(status.shard.index, filename)}; !added) {
+            problems.push_back("shard " + std::to_string(status.shard.index) + " is in both " 
+                    + it->second.string() + " and " + filename.string());
+            continue;
+        }
+        for (auto& record : status.records) {
+            if (auto [it, added]{owner.try_emplace(record.projname, status.shard.index)}; !added) {
+                problems.push_back(record.projname + " was extracted by shards " + std::to_string(it->second) 
+                        + " and " + std::to_string(status.shard.index));
+                continue;
+            }
+            ++totals[record.result];
+            if (record.result != "ok") {
+                failures.push_back(std::move(record));
+            }
+        }
+    }
+    for (std::size_t index{1}; index <= count; ++index) {
+        if (!shards.contains(index)) {
+            problems.push_back("shard " + std::to_string(index) + "/" + std::to_string(count) + " is missing");
+        }
+    }
+    out << "Shards: " << shards.size() << " of " << count << '\n'
+        << "Files: " << owner.size();
+    const char *separator{" ("};
+    for (auto result : statusResults) {
+        if (auto it{totals.find(result)}; it != totals.end()) {
+            out << separator << result << ' ' << it->second;
+            separator = ", ";
+        }
+    }
+    out << (owner.empty() ? "" : ")") << '\n';
+    for (const auto& record : failures) {
+        out << record.result << ": " << record.projname << " (" << record.mdfile.string() << "): " << record.message << '\n';
+    }
+    for (const auto& problem : problems) {
+        out << "Problem: " << problem << '\n';
+    }
+    return problems.empty() && failures.empty() ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+#ifndef SHARDSTATUS_H
+#define SHARDSTATUS_H
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/*! One of `count` parts of a batch, numbered from 1.
+ *
+ * A project belongs to a shard according to a hash of its name alone,
+ * so every node given the same files and the same count agrees on which
+ * node extracts each one, whatever order the files are listed in.
+ */
+struct Shard {
+    std::size_t index{1};
+    std::size_t count{1};
+
+    /// parse "K/N", throwing `std::runtime_error` unless 1 <= K <= N
+    static Shard parse(std::string_view text);
+    bool contains(std::string_view projname) const;
+    /// the name of this shard's status file, e.g. "autoproject-shard-2-of-4.status"
+    std::string statusFilename() const;
+};
+
+/// a 64-bit FNV-1a hash, which is the same on every platform and build
+std::uint64_t stableHash(std::string_view text);
+
+/// the outcome of extracting one file
+struct StatusRecord {
+    // "ok", "empty", "limit" or "error"
+    std::string result;
+    std::string projname;
+    fs::path mdfile;
+    // the error, or the extracted files for "ok"
+    std::string message;
+};
+
+/// the status file written by one shard
+struct ShardStatus {
+    Shard shard;
+    std::vector<StatusRecord> records{};
+};
+
+/*! write a status file: a header naming the shard, then one line per 
+ * file with tab separated fields, in which tabs, newlines and 
+ * backslashes are escaped.
+ */
+void writeStatus(std::ostream& out, const ShardStatus& status);
+/// read a status file, throwing `std::runtime_error` if it is malformed
+ShardStatus readStatus(std::istream& in);
+
+/*! combine the status files of every shard of a batch into one report.
+ *
+ * Returns zero only if every shard is present exactly once, no project
+ * was extracted by more than one shard and every file was extracted.
+ */
+int mergeStatus(std::ostream& out, std::span<const fs::path> statusfiles);
+#endif // SHARDSTATUS_H
@@ -0,0 +1,169 @@
+#include "SourceTokenizer.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+
+static bool isIdentifier(char ch) {
+    return std::isalnum(static_cast<unsigned char>(ch)) || ch == '_';
+}
+
+static bool isSpace(char ch) {
+    return std::isspace(static_cast<unsigned char>(ch));
+}
+
+// the encoding prefixes which make a string literal raw, e.g. R"(text)"
+static constexpr std::array<std::string_view, 5> rawPrefixes{"R", "LR", "uR", "UR", "u8R"};
+// true if `delimiter` may follow the opening quote of a raw string literal
+static bool isRawDelimiter(std::string_view delimiter) {
+    return delimiter.size() <= 16 && delimiter.find_first_of(" ()\\\t\"") == std::string_view::npos;
+}
+
+/*
+ * The position just after the preprocessing number starting at `pos`.
+ * Skipping it whole keeps a digit separator, as in 1'000'000, from
+ * being taken for the start of a character literal.
+ */
+static std::size_t skipNumber(std::string_view line, std::size_t pos) {
+    for (++pos; pos < line.size(); ++pos) {
+        const char ch{line[pos]};
+        if (ch == '\'' && pos + 1 < line.size() && isIdentifier(line[pos + 1])) {
+            ++pos;
+        } else if ((ch == '+' || ch == '-') && std::string_view{"eEpP"}.find(line[pos - 1]) != std::string_view::npos) {
+            continue;
+        } else if (!isIdentifier(ch) && ch != '.') {
+            break;
+        }
+    }
+    return pos;
+}
+
+void SourceTokenizer::reset(SourceDialect newDialect) {
+    dialect = newDialect;
+    state = State::code;
+    blank = true;
+    directive = false;
+}
+
+std::size_t SourceTokenizer::skipQuoted(std::string_view line, std::size_t pos) {
+    // NASM only has escapes in backquoted strings
+    const bool escapes{dialect == SourceDialect::c || quote == '`'};
+    while (pos < line.size()) {
+        const char ch{line[pos++]};
+        if (ch == '\\' && escapes) {
+            ++pos;
+        } else if (ch == quote) {
+            state = State::code;
+            return pos;
+        }
+    }
+    return line.size();
+}
+
+SourceLine SourceTokenizer::next(std::string_view line) {
+    const bool nasm{dialect == SourceDialect::nasm};
+    // a backslash at the end joins the next line to this one
+    const bool spliced{line.ends_with('\\')};
+    // everything before `kept` has been copied to `code`, less its comments
+    std::size_t kept{0};
+    bool stripped{false};
+    code.clear();
+    auto comment = [&](std::size_t start) {
+        code.append(line.substr(kept, start - kept)).push_back(' ');
+        stripped = true;
+    };
+    if (state == State::blockComment || state == State::lineComment) {
+        comment(0);
+    }
+    std::size_t pos{0};
+    while (pos < line.size()) {
+        switch (state) {
+        case State::blockComment:
+            if (auto end{line.find("*/", pos)}; end == std::string_view::npos) {
+                pos = line.size();
+            } else {
+                pos = kept = end + 2;
+                state = State::code;
+            }
+            break;
+        case State::lineComment:
+            pos = line.size();
+            break;
+        case State::quoted:
+            pos = skipQuoted(line, pos);
+            break;
+        case State::rawString:
+            if (auto end{line.find(rawEnd, pos)}; end == std::string_view::npos) {
+                pos = line.size();
+            } else {
+                pos = end + rawEnd.size();
+                state = State::code;
+            }
+            break;
+        case State::code: {
+            const char ch{line[pos]};
+            const auto two{line.substr(pos, 2)};
+            if (isSpace(ch)) {
+                ++pos;
+            } else if (!nasm && two == "/*") {
+                comment(pos);
+                state = State::blockComment;
+                pos += 2;
+            } else if (nasm ? ch == ';' : two == "//") {
+                comment(pos);
+                state = State::lineComment;
+                pos = line.size();
+            } else {
+                // a directive may only have whitespace and comments before it
+                if (blank && ch == (nasm ? '%' : '#')) {
+                    directive = true;
+                }
+                blank = false;
+                if (ch == '"' || ch == '\'' || (nasm && ch == '`')) {
+                    auto prefix{pos};
+                    while (prefix > 0 && isIdentifier(line[prefix - 1])) {
+                        --prefix;
+                    }
+                    const auto open{line.find('(', pos + 1)};
+                    if (!nasm && ch == '"' && open != std::string_view::npos 
+                            && isRawDelimiter(line.substr(pos + 1, open - pos - 1))
+                            && std::find(rawPrefixes.begin(), rawPrefixes.end(), line.substr(prefix, pos - prefix))
+                            != rawPrefixes.end()) {
+                        rawEnd.assign(")").append(line.substr(pos + 1, open - pos - 1)).push_back('"');
+                        state = State::rawString;
+                        pos = open + 1;
+                    } else {
+                        quote = ch;
+                        state = State::quoted;
+                        ++pos;
+                    }
+                } else if (!nasm && std::isdigit(static_cast<unsigned char>(ch))) {
+                    pos = skipNumber(line, pos);
+                } else if (isIdentifier(ch)) {
+                    while (pos < line.size() && isIdentifier(line[pos])) {
+                        ++pos;
+                    }
+                } else {
+                    ++pos;
+                }
+            }
+            break;
+        }
+        }
+    }
+    if (stripped && state != State::blockComment && state != State::lineComment) {
+        code.append(line.substr(kept));
+    }
+    const bool isDirective{directive};
+    if (!spliced) {
+        // neither a line comment nor an ordinary literal goes past the end of the line
+        if (state == State::lineComment || state == State::quoted) {
+            state = State::code;
+        }
+        // but a block comment or a raw string literal continues the logical line
+        if (state == State::code) {
+            blank = true;
+            directive = false;
+        }
+    }
+    return {line, stripped ? std::string_view{code} : line, isDirective};
+}
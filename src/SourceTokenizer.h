@@ -0,0 +1,60 @@
+#ifndef SOURCETOKENIZER_H
+#define SOURCETOKENIZER_H
+#include <string>
+#include <string_view>
+
+/// the comment, string and directive syntax of a language's sources
+enum class SourceDialect {
+    c,      // C and C++: `//` and `/* */` comments and `#` directives
+    nasm,   // NASM: `;` comments and `%` directives
+};
+
+/// one line of source as seen by a `SourceTokenizer`
+struct SourceLine {
+    // the line as written
+    std::string_view text;
+    // the line with each comment replaced by a space
+    std::string_view code;
+    // true if the line is all or part of a preprocessor directive
+    bool directive{false};
+};
+
+/*! Follows the comments, string literals and preprocessor directives of
+ * a source file one line at a time, so that the rules can tell a real
+ * `#include` from one which is commented out or inside a string.
+ *
+ * This is not a full lexer: it only tracks what can carry over from one
+ * line to the next, i.e. block comments, raw string literals and lines
+ * continued with a backslash, and what starts a comment or a directive.
+ * A literal left unterminated at the end of a line ends there, as most
+ * compilers would recover, so one bad line can't hide the rest of a file.
+ */
+class SourceTokenizer {
+public:
+    explicit SourceTokenizer(SourceDialect dialect = SourceDialect::c) : dialect{dialect} {}
+    /*! tokenize `line`, the next line of the file.
+     *
+     * The views returned are valid until the next call and for as long
+     * as `line` itself.
+     */
+    SourceLine next(std::string_view line);
+    /// start a new file in `newDialect`
+    void reset(SourceDialect newDialect);
+
+private:
+    enum class State { code, blockComment, lineComment, quoted, rawString };
+    // the position just after the literal starting at `pos`, or `line.size()`
+    std::size_t skipQuoted(std::string_view line, std::size_t pos);
+    SourceDialect dialect;
+    State state{State::code};
+    // the closing quote of the literal being read
+    char quote{'"'};
+    // the end of the raw string literal being read, e.g. `)xyz"`
+    std::string rawEnd;
+    // nothing but whitespace and comments since the logical line began
+    bool blank{true};
+    bool directive{false};
+    // the code of the last line, if it had any comments
+    std::string code;
+};
+#endif // SOURCETOKENIZER_H
@@ -0,0 +1,44 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+/*! A bounded lock-free queue for exactly one producer and one consumer.
+ *
+ * The indices only ever increase, so `tail - head` is the number of
+ * items queued.  A full or empty queue waits on the other side's index
+ * with `std::atomic::wait` rather than spinning.
+ */
+template <typename T, std::size_t N>
+class SpscQueue {
+    static_assert(N && (N & (N - 1)) == 0, "capacity must be a power of two");
+public:
+    void push(T item) {
+        const auto t{tail.load(std::memory_order_relaxed)};
+        for (auto h{head.load(std::memory_order_acquire)}; t - h == N; h = head.load(std::memory_order_acquire)) {
+            head.wait(h, std::memory_order_acquire);
+        }
+        slots[t % N] = std::move(item);
+        tail.store(t + 1, std::memory_order_release);
+        tail.notify_one();
+    }
+
+    T pop() {
+        const auto h{head.load(std::memory_order_relaxed)};
+        for (auto t{tail.load(std::memory_order_acquire)}; t == h; t = tail.load(std::memory_order_acquire)) {
+            tail.wait(t, std::memory_order_acquire);
+        }
+        T item{std::move(slots[h % N])};
+        head.store(h + 1, std::memory_order_release);
+        head.notify_one();
+        return item;
+    }
+
+private:
+    std::array<T, N> slots;
+    alignas(64) std::atomic<std::size_t> head{0};
+    alignas(64) std::atomic<std::size_t> tail{0};
+};
+#endif // SPSCQUEUE_H
@@ -0,0 +1,160 @@
+#include "Superbuild.h"
+#include <string_view>
+
+/*
+ * Packages are looked for without REQUIRED, so that a missing one only
+ * stops the project which needs it.  What is missing is noted for
+ * `autoproject_add`, which also makes a stand-in for any imported target
+ * that still doesn't exist, so that the build files can be generated.
+ * FindPkgConfig is included afresh by each project that uses it, so its
+ * commands are wrapped in a module found ahead of it on the module path.
+ */
+static constexpr std::string_view superbuildFunctions{R"cmake(
+set_property(GLOBAL PROPERTY AUTOPROJECT_MISSING "")
+macro(find_package autoproject_package)
+    set(autoproject_args ${ARGN})
+    list(REMOVE_ITEM autoproject_args REQUIRED)
+    _find_package(${autoproject_package} ${autoproject_args})
+    if(";${ARGN};" MATCHES ";REQUIRED;" AND NOT ${autoproject_package}_FOUND)
+        set_property(GLOBAL APPEND PROPERTY AUTOPROJECT_MISSING ${autoproject_package})
+    endif()
+endmacro()
+file(WRITE "${CMAKE_BINARY_DIR}/autoproject/FindPkgConfig.cmake" [=[
+include("${CMAKE_ROOT}/Modules/FindPkgConfig.cmake")
+macro(pkg_check_modules autoproject_prefix)
+    set(autoproject_args ${ARGN})
+    list(REMOVE_ITEM autoproject_args REQUIRED)
+    _pkg_check_modules(${autoproject_prefix} ${autoproject_args})
+    if(";${ARGN};" MATCHES ";REQUIRED;" AND NOT ${autoproject_prefix}_FOUND)
+        set_property(GLOBAL APPEND PROPERTY AUTOPROJECT_MISSING ${autoproject_prefix})
+    endif()
+endmacro()
+macro(pkg_search_module autoproject_prefix)
+    set(autoproject_args ${ARGN})
+    list(REMOVE_ITEM autoproject_args REQUIRED)
+    _pkg_search_module(${autoproject_prefix} ${autoproject_args})
+    if(";${ARGN};" MATCHES ";REQUIRED;" AND NOT ${autoproject_prefix}_FOUND)
+        set_property(GLOBAL APPEND PROPERTY AUTOPROJECT_MISSING ${autoproject_prefix})
+    endif()
+endmacro()
+]=])
+list(PREPEND CMAKE_MODULE_PATH "${CMAKE_BINARY_DIR}/autoproject")
+
+# every target of `kind` (BUILDSYSTEM_TARGETS or IMPORTED_TARGETS) in `dir` and its subdirectories
+function(autoproject_targets var kind dir)
+    get_directory_property(targets DIRECTORY "${dir}" ${kind})
+    get_directory_property(subdirs DIRECTORY "${dir}" SUBDIRECTORIES)
+    foreach(subdir IN LISTS subdirs)
+        autoproject_targets(more ${kind} "${subdir}")
+        list(APPEND targets ${more})
+    endforeach()
+    set(${var} ${targets} PARENT_SCOPE)
+endfunction()
+
+# add the project in `dir`, or leave it out of the build if anything it needs is missing
+function(autoproject_add name dir language)
+    if(NOT CMAKE_${language}_COMPILER)
+        message(STATUS "Leaving out ${name}: no ${language} compiler")
+        set_property(GLOBAL APPEND PROPERTY AUTOPROJECT_LEFT_OUT ${name})
+        return()
+    endif()
+    set_property(GLOBAL PROPERTY AUTOPROJECT_MISSING "")
+    set(AUTOPROJECT_TARGET_PREFIX "${name}_")
+    add_subdirectory("${dir}" "${name}")
+    get_property(missing GLOBAL PROPERTY AUTOPROJECT_MISSING)
+    get_property(standins GLOBAL PROPERTY AUTOPROJECT_STANDINS)
+    autoproject_targets(targets BUILDSYSTEM_TARGETS "${dir}")
+    # imported targets which were found are only visible within the project
+    autoproject_targets(imported IMPORTED_TARGETS "${dir}")
+    foreach(target IN LISTS targets)
+        get_target_property(type ${target} TYPE)
+        if(NOT type STREQUAL "UTILITY")
+            get_target_property(libraries ${target} LINK_LIBRARIES)
+            foreach(library IN LISTS libraries)
+                if(library IN_LIST standins)
+                    list(APPEND missing ${library})
+                elseif(library MATCHES "^[A-Za-z0-9_.+-]+::[A-Za-z0-9_.+-]+$" AND NOT TARGET ${library} AND NOT library IN_LIST imported)
+                    add_library(${library} INTERFACE IMPORTED GLOBAL)
+                    set_property(GLOBAL APPEND PROPERTY AUTOPROJECT_STANDINS ${library})
+                    list(APPEND missing ${library})
+                endif()
+            endforeach()
+        endif()
+    endforeach()
+    if(missing)
+        list(REMOVE_DUPLICATES missing)
+        list(JOIN missing ", " missing)
+        message(STATUS "Leaving out ${name}: ${missing} not found")
+        set_property(TARGET ${targets} PROPERTY EXCLUDE_FROM_ALL ON)
+        set_property(GLOBAL APPEND PROPERTY AUTOPROJECT_LEFT_OUT ${name})
+    endif()
+endfunction()
+)cmake"};
+
+std::string uniqueTargetName(std::string_view projname, std::set<std::string>& used) {
+    const auto base{cmakeTargetName(projname)};
+    auto name{base};
+    for (unsigned n{2}; used.contains(name); ++n) {
+        name = base + "_" + std::to_string(n);
+    }
+    used.insert(name);
+    return name;
+}
+
+// `text` as a quoted CMake argument
+static std::string cmakeQuote(std::string_view text) {
+    std::string quoted{"\""};
+    for (auto ch : text) {
+        if (ch == '\\' || ch == '"' || ch == '$') {
+            quoted.push_back('\\');
+        }
+        quoted.push_back(ch);
+    }
+    quoted.push_back('"');
+    return quoted;
+}
+
+// the CMake language a project is compiled as
+static std::string_view cmakeLanguage(std::string_view lang) {
+    if (lang == "c") {
+        return "C";
+    }
+    return lang == "asm" ? "ASM_NASM" : "CXX";
+}
+
+void writeSuperbuild(std::ostream& out, const fs::path& dir, const std::vector<BuildInfo>& projects) {
+    bool nasm{false};
+    for (const auto& project : projects) {
+        nasm = nasm || project.lang == "asm";
+    }
+    out << "# CMakeLists.txt for a superbuild of " << projects.size() << " projects, written by autoproject\n"
+        << "#\n"
+        << "# Configure once and build every project, keeping going past failures, e.g.\n"
+        << "#     cmake -S . -B build -G Ninja && cmake --build build -- -k 0\n"
+        << "# A project which needs a package that can't be found is left out.\n"
+        << "cmake_minimum_required(VERSION 3.21)\n"
+        << "project(superbuild LANGUAGES C CXX)\n";
+    if (nasm) {
+        out << "include(CheckLanguage)\n"
+            << "check_language(ASM_NASM)\n"
+            << "if(CMAKE_ASM_NASM_COMPILER)\n"
+            << "    enable_language(ASM_NASM)\n"
+            << "endif()\n";
+    }
+    out << superbuildFunctions << '\n';
+    const auto base{fs::absolute(dir).lexically_normal()};
+    for (const auto& project : projects) {
+        auto path{fs::absolute(project.outdir).lexically_normal().lexically_relative(base)};
+        if (path.empty()) {
+            path = fs::absolute(project.outdir);
+        }
+        out << "autoproject_add(" << project.target << ' ' << cmakeQuote(path.generic_string()) << ' '
+            << cmakeLanguage(project.lang) << ")\n";
+    }
+    out << "\nget_property(left_out GLOBAL PROPERTY AUTOPROJECT_LEFT_OUT)\n"
+        << "if(left_out)\n"
+        << "    list(LENGTH left_out count)\n"
+        << "    list(JOIN left_out \", \" left_out)\n"
+        << "    message(WARNING \"Left out ${count} of " << projects.size() << " projects: ${left_out}\")\n"
+        << "endif()\n";
+}
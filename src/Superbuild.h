@@ -0,0 +1,28 @@
+#ifndef SUPERBUILD_H
+#define SUPERBUILD_H
+#include "AutoProject.h"
+#include <filesystem>
+#include <ostream>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/*! the `cmakeTargetName` of `projname`, with a number appended if that
+ * is already in `used`.  The name returned is added to `used`.
+ */
+std::string uniqueTargetName(std::string_view projname, std::set<std::string>& used);
+
+/*! write the top level CMakeLists.txt of a superbuild in `dir`, which
+ * adds each of `projects` with `add_subdirectory`.
+ *
+ * Configuring it detects the compilers once, and one build then builds
+ * every project in parallel.  Each project's targets are named by its
+ * `BuildInfo::target`, so those must be unique.  A project which needs
+ * a package that can't be found is left out of the build rather than
+ * failing the configure step for every project.
+ */
+void writeSuperbuild(std::ostream& out, const fs::path& dir, const std::vector<BuildInfo>& projects);
+#endif // SUPERBUILD_H
@@ -0,0 +1,126 @@
+#include "SyntaxCheck.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <utility>
+#ifndef _WIN32
+#include <sys/wait.h>
+#endif
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+int runCommand(const std::string& command, std::string& output) {
+    FILE *pipe{popen((command + " 2>&1").c_str(), "r")};
+    if (!pipe) {
+        output = "cannot run " + command;
+        return -1;
+    }
+    char buffer[4096];
+    for (std::size_t len; (len = std::fread(buffer, 1, sizeof buffer, pipe)) != 0; ) {
+        output.append(buffer, len);
+    }
+    int status{pclose(pipe)};
+#ifndef _WIN32
+    if (status != -1) {
+        status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+#endif
+    return status;
+}
+
+SyntaxChecker::SyntaxChecker(unsigned jobs) :
+    jobs{jobs ? jobs : std::max(1u, std::thread::hardware_concurrency())}
+{}
+
+void SyntaxChecker::add(const BuildInfo& project) {
+    std::string problem;
+    if (project.lang.empty()) {
+        problem = "no language tag found";
+    } else if (project.compiler.empty()) {
+        problem = "no compiler configured for language \"" + project.lang + "\"";
+    }
+    const auto before{results.size()};
+    if (problem.empty()) {
+        for (const auto& file : project.sources) {
+            if (isTranslationUnit(file)) {
+                results.push_back({project.projname, file, command(project, file)});
+            }
+        }
+        if (results.size() == before) {
+            problem = "no translation units";
+        }
+    }
+    if (!problem.empty()) {
+        results.push_back({project.projname, {}, {}, -1, problem});
+    }
+}
+
+std::vector<CheckResult> SyntaxChecker::run() {
+    std::atomic<std::size_t> next{0};
+    auto worker = [this, &next]{
+        for (auto i{next++}; i < results.size(); i = next++) {
+            if (!results[i].command.empty()) {
+                results[i].status = runCommand(results[i].command, results[i].output);
+            }
+        }
+    };
+    std::vector<std::jthread> workers;
+    for (unsigned i{0}; i < std::min<std::size_t>(jobs, results.size()); ++i) {
+        workers.emplace_back(worker);
+    }
+    workers.clear();
+    return std::exchange(results, {});
+}
+
+std::string SyntaxChecker::command(const BuildInfo& project, const fs::path& file) {
+    std::stringstream cmd;
+    cmd << project.compiler;
+    for (const auto& flags : {project.flags, project.syntaxcheckflags}) {
+        if (!flags.empty()) {
+            cmd << ' ' << flags;
+        }
+    }
+    // nasm requires the trailing separator on include directories
+    cmd << " -I" << std::quoted((project.srcdir / "").string()) << ' ' << std::quoted(file.string());
+    return cmd.str();
+}
+
+std::size_t reportCheck(std::ostream& out, const std::vector<CheckResult>& results) {
+    std::size_t failedProjects{0};
+    std::size_t projects{0};
+    for (auto first{results.begin()}; first != results.end(); ) {
+        auto last{std::find_if(first, results.end(), [first](const CheckResult& r){
+                return r.projname != first->projname; })};
+        std::size_t failed{0};
+        for (auto it{first}; it != last; ++it) {
+            if (it->file.empty()) {
+                out << "SKIP  " << it->projname << ": " << it->output << '\n';
+                ++failed;
+                continue;
+            }
+            out << (it->status ? "FAIL  " : "ok    ") << it->projname << '/' << it->file.filename().string() << '\n';
+            if (it->status) {
+                ++failed;
+                std::istringstream lines{it->output};
+                for (std::string line; std::getline(lines, line); ) {
+                    out << "      " << line << '\n';
+                }
+            }
+        }
+        out << "Project " << first->projname << ": "
+            << (failed ? "FAILED" : "passed") << " (" << (last - first - failed) << " of "
+            << (last - first) << " files ok)\n";
+        failedProjects += failed != 0;
+        ++projects;
+        first = last;
+    }
+    out << "Checked " << projects << " projects: " << (projects - failedProjects)
+        << " passed, " << failedProjects << " failed\n";
+    return failedProjects;
+}
@@ -0,0 +1,58 @@
+#ifndef SYNTAXCHECK_H
+#define SYNTAXCHECK_H
+#include "AutoProject.h"
+#include <cstddef>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/// the outcome of checking one translation unit
+struct CheckResult {
+    std::string projname;
+    fs::path file;
+    std::string command;
+    // exit status of the compiler, or -1 if it could not be run; a project
+    // which cannot be checked at all has a single result with no file
+    int status{-1};
+    // everything the compiler wrote to stdout and stderr
+    std::string output{};
+};
+
+/*! Triage of extracted projects without running CMake.
+ *
+ * Each translation unit of each added project is passed directly to the
+ * project's compiler with its syntax check flags, which is far quicker
+ * than configuring and building a CMake tree.  Up to `jobs` compilers
+ * run at once.
+ */
+class SyntaxChecker {
+public:
+    explicit SyntaxChecker(unsigned jobs);
+    /// queue every translation unit of the project
+    void add(const BuildInfo& project);
+    /// check everything added, returning the results in the order added
+    std::vector<CheckResult> run();
+    /// the shell command which checks `file` of `project`
+    static std::string command(const BuildInfo& project, const fs::path& file);
+
+private:
+    unsigned jobs;
+    std::vector<CheckResult> results;
+};
+
+/*! run `command` with the shell, appending what it writes to stdout and
+ * stderr to `output`.
+ *
+ * Returns its exit status, or -1 if it could not be run.
+ */
+int runCommand(const std::string& command, std::string& output);
+
+/*! write the results per file and per project to `out`.
+ *
+ * Returns the number of projects with at least one failure.
+ */
+std::size_t reportCheck(std::ostream& out, const std::vector<CheckResult>& results);
+#endif // SYNTAXCHECK_H
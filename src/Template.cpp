@@ -0,0 +1,61 @@
+#include "Template.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+Template::Template(std::span<const Segment> segments) :
+    segments{segments.begin(), segments.end()}
+{}
+
+Template::Template(std::string text) :
+    text{std::move(text)}
+{
+    forEachSegment(this->text, [this](const Segment& s){ segments.push_back(s); });
+}
+
+std::shared_ptr<const Template> Template::load(const fs::path& filename) {
+    std::ifstream in{filename};
+    if (!in) {
+        throw std::runtime_error("cannot open template file \"" + filename.string() + "\"");
+    }
+    std::stringstream text;
+    text << in.rdbuf();
+    return std::make_shared<const Template>(text.str());
+}
+
+void Template::render(std::ostream& out, std::span<const Value> values) const {
+    // whether the line so far has any text, and any placeholder without a value
+    bool text{false};
+    bool missing{false};
+    for (const auto& segment : segments) {
+        if (segment.placeholder) {
+            auto it{std::find_if(values.begin(), values.end(), [&segment](const auto& v){ return v.first == segment.text; })};
+            if (it != values.end()) {
+                out << it->second;
+                text = true;
+            } else {
+                missing = true;
+            }
+            continue;
+        }
+        for (auto rest{segment.text}; !rest.empty(); ) {
+            const auto eol{rest.find('\n')};
+            const auto part{rest.substr(0, eol)};
+            out << part;
+            text = text || !part.empty();
+            if (eol == std::string_view::npos) {
+                break;
+            }
+            if (text || !missing) {
+                out << '\n';
+            }
+            text = missing = false;
+            rest.remove_prefix(eol + 1);
+        }
+    }
+    // like the line-at-a-time copy this replaces, always end with a newline
+    if (text || (!missing && !segments.empty() && (segments.back().placeholder || !segments.back().text.ends_with('\n')))) {
+        out << '\n';
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef TEMPLATE_H
+#define TEMPLATE_H
+#include <array>
+#include <filesystem>
+#include <initializer_list>
+#include <memory>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/// a run of literal text or, if `placeholder` is set, the name of a placeholder
+struct Segment {
+    std::string_view text;
+    bool placeholder;
+};
+
+/// the names which may appear in braces, e.g. `{projname}`, in a CMake template
+inline constexpr std::array<std::string_view, 7> placeholders{
+    "projname", "extras", "srcnames", "libraries", "launcher", "clonedir", "harness"
+};
+
+constexpr bool isPlaceholder(std::string_view name) {
+    for (auto p : placeholders) {
+        if (p == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*! call `f` with each segment of the template text.
+ *
+ * Braces which do not surround a known placeholder name, such as those 
+ * in a CMake `${variable}`, are left as literal text.
+ */
+template <typename F>
+constexpr void forEachSegment(std::string_view text, F&& f) {
+    std::size_t start{0};
+    for (auto pos{text.find('{')}; pos != std::string_view::npos; pos = text.find('{', pos + 1)) {
+        auto end{text.find('}', pos)};
+        if (end == std::string_view::npos) {
+            break;
+        }
+        auto name{text.substr(pos + 1, end - pos - 1)};
+        if (isPlaceholder(name)) {
+            if (pos > start) {
+                f(Segment{text.substr(start, pos - start), false});
+            }
+            f(Segment{name, true});
+            start = end + 1;
+            pos = end;
+        }
+    }
+    if (start < text.size()) {
+        f(Segment{text.substr(start), false});
+    }
+}
+
+constexpr std::size_t countSegments(std::string_view text) {
+    std::size_t count{0};
+    forEachSegment(text, [&count](const Segment&){ ++count; });
+    return count;
+}
+
+/// split template text into segments at compile time
+template <std::size_t N>
+constexpr std::array<Segment, N> segmentTemplate(std::string_view text) {
+    std::array<Segment, N> segments{};
+    std::size_t i{0};
+    forEachSegment(text, [&](const Segment& s){ segments[i++] = s; });
+    return segments;
+}
+
+/*! A CMake file template, split once into literal text and placeholders
+ * so that writing a project is a simple concatenation.
+ */
+class Template {
+public:
+    /// a template using segments with static storage, e.g. built-in defaults
+    explicit Template(std::span<const Segment> segments);
+    /// a template from text read at run time
+    explicit Template(std::string text);
+    Template(const Template&) = delete;
+    Template& operator=(const Template&) = delete;
+    /// read and split the named template file; throws if it can't be read
+    static std::shared_ptr<const Template> load(const fs::path& filename);
+    using Value = std::pair<std::string_view, std::string_view>;
+    using Values = std::initializer_list<Value>;
+    /*! write the template, replacing each placeholder with its value.
+     *
+     * A placeholder with no value is replaced by nothing, and a line with
+     * nothing on it but such placeholders is left out altogether, so an
+     * optional line such as `{harness}` leaves no blank line behind.
+     */
+    void render(std::ostream& out, std::span<const Value> values) const;
+    void render(std::ostream& out, Values values) const {
+        render(out, std::span<const Value>{values.begin(), values.size()});
+    }
+
+private:
+    std::string text;
+    std::vector<Segment> segments;
+};
+#endif // TEMPLATE_H
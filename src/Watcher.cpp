@@ -0,0 +1,236 @@
+#include "Watcher.h"
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace std::literals;
+
+static const std::string mdextension{".md"};
+// how often to check for a stop request when nothing is pending
+static constexpr std::chrono::milliseconds idlePoll{250};
+
+Watcher::Watcher(fs::path dir, std::shared_ptr<ConfigStore> config, WatchOptions options, std::ostream& out) :
+    dir{dir},
+    config{std::move(config)},
+    lastReload{std::chrono::steady_clock::now()},
+    options{options},
+    out{out},
+    queue{options.queueDepth}
+{
+    if (!fs::is_directory(dir)) {
+        throw std::runtime_error("Cannot watch "s + dir.string() + ": not a directory");
+    }
+    if (this->options.workers == 0) {
+        this->options.workers = 1;
+    }
+#ifdef __linux__
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "inotify_init1");
+    }
+    if (inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        auto err{errno};
+        close(fd);
+        throw std::system_error(err, std::generic_category(), "Cannot watch "s + dir.string());
+    }
+#else
+    throw std::runtime_error("Watch mode is only supported on Linux");
+#endif
+}
+
+Watcher::~Watcher() {
+#ifdef __linux__
+    if (fd >= 0) {
+        close(fd);
+    }
+#endif
+}
+
+void Watcher::run() {
+    std::vector<std::thread> pool;
+    for (unsigned i{0}; i < options.workers; ++i) {
+        pool.emplace_back(&Watcher::worker, this);
+    }
+#ifdef __linux__
+    while (!stopping) {
+        pollfd pfd{fd, POLLIN, 0};
+        auto timeout{pending.empty() ? idlePoll : options.debounce};
+        int n = poll(&pfd, 1, static_cast<int>(timeout.count()));
+        if (n < 0 && errno != EINTR) {
+            queue.close();
+            for (auto& t : pool) {
+                t.join();
+            }
+            throw std::system_error(errno, std::generic_category(), "poll");
+        }
+        if (n > 0) {
+            readEvents();
+        }
+        dispatch(false);
+        reload();
+    }
+#endif
+    // anything still settling is complete as far as we will ever know
+    dispatch(true);
+    queue.close();
+    for (auto& t : pool) {
+        t.join();
+    }
+}
+
+void Watcher::stop() {
+    stopping = true;
+}
+
+void Watcher::readEvents() {
+#ifdef __linux__
+    alignas(inotify_event) char buffer[4096];
+    const auto now{std::chrono::steady_clock::now()};
+    for (;;) {
+        auto len = read(fd, buffer, sizeof buffer);
+        if (len <= 0) {
+            break;
+        }
+        for (char *ptr = buffer; ptr < buffer + len; ) {
+            const auto *event = reinterpret_cast<const inotify_event *>(ptr);
+            ptr += sizeof(inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                rescan();
+            } else if (event->len && !(event->mask & IN_ISDIR)) {
+                fs::path name{event->name};
+                if (name.extension() == mdextension) {
+                    pending[dir / name] = now;
+                }
+            }
+        }
+    }
+#endif
+}
+
+/*
+ * If the kernel event queue overflowed, we no longer know which files
+ * arrived, so queue every .md file that has not yet been extracted, i.e.
+ * which has no project where the current output layout would put it.
+ */
+void Watcher::rescan() {
+    const auto now{std::chrono::steady_clock::now()};
+    const auto snapshot{config->current()};
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        const auto& path{entry.path()};
+        if (entry.is_regular_file() && path.extension() == mdextension) {
+            if (!fs::exists(snapshot->layout.directory(path))) {
+                pending[path] = now;
+            }
+        }
+    }
+}
+
+/*
+ * A file is never extracted by two workers at once.  One which changes
+ * while it is queued is left to the worker that takes it, which reads it
+ * afresh; one which changes while it is being extracted stays pending
+ * until that extraction has finished, and then is queued again.
+ */
+void Watcher::dispatch(bool all) {
+    const auto now{std::chrono::steady_clock::now()};
+    for (auto it{pending.begin()}; it != pending.end(); ) {
+        if (all || now - it->second >= options.debounce) {
+            std::unique_lock<std::mutex> lock{flightmtx};
+            if (all) {
+                finished.wait(lock, [&]{ return !running.contains(it->first); });
+            } else if (running.contains(it->first)) {
+                ++it;
+                continue;
+            }
+            if (queued.insert(it->first).second) {
+                lock.unlock();
+                // blocks while the workers are saturated
+                queue.push(it->first);
+            }
+            it = pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// publish a new configuration if its files have changed
+void Watcher::reload() {
+    const auto now{std::chrono::steady_clock::now()};
+    if (options.reload.count() == 0 || now - lastReload < options.reload) {
+        return;
+    }
+    lastReload = now;
+    try {
+        if (config->refresh()) {
+            report("Reloaded the configuration, now version " + std::to_string(config->version()) + "\n");
+        }
+    }
+    catch(const std::exception& e) {
+        report("Error: cannot reload the configuration: "s + e.what() + "\nStill using version " 
+                + std::to_string(config->version()) + "\n");
+    }
+}
+
+/*
+ * Each worker reuses one fixed buffer for the per-project state of every
+ * file it extracts, so memory use stays flat however many files arrive.
+ * It also has its own writer, so each worker's output is submitted on 
+ * its own io_uring, and keeps its configuration snapshot from one file to
+ * the next, only fetching another when a reload has published one.
+ */
+void Watcher::worker() {
+    std::vector<std::byte> buffer(options.arenaSize);
+    std::pmr::monotonic_buffer_resource arena{buffer.data(), buffer.size()};
+    auto writer{OutputWriter::create(options.asyncOutput)};
+    OutputBatch batch;
+    std::shared_ptr<const ConfigSnapshot> snapshot;
+    while (auto mdfile = queue.pop()) {
+        {
+            std::lock_guard<std::mutex> lock{flightmtx};
+            queued.erase(*mdfile);
+            running.insert(*mdfile);
+        }
+        config->update(snapshot);
+        extract(*mdfile, snapshot, &arena, *writer, batch);
+        arena.release();
+        batch.clear();
+        {
+            std::lock_guard<std::mutex> lock{flightmtx};
+            running.erase(*mdfile);
+        }
+        finished.notify_all();
+    }
+}
+
+void Watcher::extract(const fs::path& mdfile, std::shared_ptr<const ConfigSnapshot> snapshot, 
+        std::pmr::memory_resource *arena, OutputWriter& writer, OutputBatch& batch) 
+{
+    std::stringstream msg;
+    try {
+        AutoProject ap{mdfile, std::move(snapshot), arena};
+        if (ap.createProject(options.overwrite, batch)) {
+            writer.write(batch);
+            msg << ap;
+            ++projects;
+        } else {
+            msg << "No source files found in " << mdfile << '\n';
+        }
+    }
+    catch(const std::exception& e) {
+        msg << "Error: " << e.what() << '\n';
+    }
+    report(msg.str());
+}
+
+void Watcher::report(const std::string& msg) {
+    std::lock_guard<std::mutex> lock{outmtx};
+    out << msg << std::flush;
+}
@@ -0,0 +1,96 @@
+#ifndef WATCHER_H
+#define WATCHER_H
+#include "AutoProject.h"
+#include "ConfigSnapshot.h"
+#include "WorkQueue.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct WatchOptions {
+    // number of extraction threads
+    unsigned workers{std::thread::hardware_concurrency()};
+    // maximum number of files waiting for a worker before the watcher blocks
+    std::size_t queueDepth{64};
+    // how long a file must be quiet before it is extracted
+    std::chrono::milliseconds debounce{200};
+    // bytes of per-worker arena reused for each extraction
+    std::size_t arenaSize{256 * 1024};
+    bool overwrite{false};
+    // write each project's files with io_uring where available
+    bool asyncOutput{false};
+    // how often to check whether the configuration has changed; zero never checks
+    std::chrono::milliseconds reload{1000};
+};
+
+/*! Watches a directory and extracts each `.md` file that appears in it.
+ *
+ * Files are picked up when they are closed after writing or moved into
+ * the directory.  Each file must then be quiet for `debounce` before it
+ * is queued, so a file written in several bursts is only extracted once.
+ * A file is never extracted by two workers at once: one rewritten while
+ * it is being extracted is extracted again once that has finished.
+ * Extraction happens on a pool of worker threads which all share the
+ * same preloaded language settings and rules.
+ *
+ * When the configuration file, or a language's rules or templates, 
+ * change, the new configuration is used for each file extracted after
+ * that; the files already being extracted finish with the old one.  If
+ * the new configuration is bad, the old one stays in use.
+ */
+class Watcher {
+public:
+    Watcher(fs::path dir, std::shared_ptr<ConfigStore> config, WatchOptions options, std::ostream& out);
+    ~Watcher();
+    Watcher(const Watcher&) = delete;
+    Watcher& operator=(const Watcher&) = delete;
+    /// watch and extract until `stop` is called
+    void run();
+    /// ask `run` to finish; safe to call from a signal handler
+    void stop();
+    /// number of projects successfully extracted so far
+    std::size_t extracted() const { return projects; }
+
+private:
+    void readEvents();
+    void rescan();
+    void dispatch(bool all);
+    void reload();
+    void worker();
+    void extract(const fs::path& mdfile, std::shared_ptr<const ConfigSnapshot> snapshot, 
+            std::pmr::memory_resource *arena, OutputWriter& writer, OutputBatch& batch);
+    void report(const std::string& msg);
+
+    fs::path dir;
+    std::shared_ptr<ConfigStore> config;
+    std::chrono::steady_clock::time_point lastReload;
+    WatchOptions options;
+    std::ostream& out;
+    std::mutex outmtx;
+    WorkQueue<fs::path> queue;
+    std::map<fs::path, std::chrono::steady_clock::time_point> pending;
+    // guards `queued` and `running`; `finished` is signalled as each file is done
+    std::mutex flightmtx;
+    std::condition_variable finished;
+    // files on `queue` which no worker has taken yet
+    std::set<fs::path> queued;
+    // files being extracted
+    std::set<fs::path> running;
+    std::atomic<bool> stopping{false};
+    std::atomic<std::size_t> projects{0};
+    int fd{-1};
+};
+#endif // WATCHER_H
@@ -0,0 +1,68 @@
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+/*! A bounded, blocking, multi-producer multi-consumer queue.
+ *
+ * `push` blocks while the queue is full, which is how a slow consumer
+ * applies backpressure to the producer.  After `close`, pushes are
+ * refused and `pop` drains whatever remains before returning empty.
+ */
+template <typename T>
+class WorkQueue {
+public:
+    explicit WorkQueue(std::size_t capacity) : capacity{capacity ? capacity : 1} {}
+    WorkQueue(const WorkQueue&) = delete;
+    WorkQueue& operator=(const WorkQueue&) = delete;
+
+    /// add an item, waiting for room; returns false if the queue is closed
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock{mtx};
+        notFull.wait(lock, [this]{ return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /// remove an item, waiting for one; returns empty once closed and drained
+    std::optional<T> pop() {
+        std::unique_lock<std::mutex> lock{mtx};
+        notEmpty.wait(lock, [this]{ return closed || !items.empty(); });
+        if (items.empty()) {
+            return std::nullopt;
+        }
+        T item{std::move(items.front())};
+        items.pop_front();
+        notFull.notify_one();
+        return item;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock{mtx};
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+    std::size_t size() const {
+        std::lock_guard<std::mutex> lock{mtx};
+        return items.size();
+    }
+
+private:
+    const std::size_t capacity;
+    mutable std::mutex mtx;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::deque<T> items;
+    bool closed{false};
+};
+#endif // WORKQUEUE_H
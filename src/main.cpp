@@ -1,10 +1,32 @@
 #include "config.h"
 #include "AutoProject.h"
+#include "CompileCommands.h"
 #include "ConfigFile.h"
+#include "ConfigSnapshot.h"
+#include "NativeHost.h"
+#include "NinjaFile.h"
+#include "RuleProfiler.h"
+#include "ShardStatus.h"
+#include "Superbuild.h"
+#include "SyntaxCheck.h"
+#include "Watcher.h"
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
 #include <iostream>
+#include <iterator>
 #include <string>
 #include <string_view>
 #include <map>
+#include <memory_resource>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <span>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
 
 constexpr std::string_view license{R"(
 
@@ -36,32 +58,356 @@ constexpr std::string_view license{R"(
 
 static const std::string defaultconfigfilename{DATAFILE_DIR "/config/autoproject.conf"};
 static constexpr std::string_view version{"autoproject " VERSION};
-static constexpr std::string_view usage{"Usage: autoproject project.md\n"
-    "Creates a CMake build tree under 'project' subdirectory\n"};
-
-std::map<std::string, LangConfig> fetchLanguageSettings(const ConfigFile &cfg) {
-    std::map<std::string, LangConfig> lang;
-    auto configfiledir = cfg.get_value("General", "ConfigFileDir");
-    for (const auto& section : cfg) {
-        if (section.first != "general") {
-            fs::path basedir = lang[section.first].configdir = configfiledir + "/" + cfg.get_value(section.first, "Subdir");
-            lang[section.first].rulesfilename = basedir / cfg.get_value(section.first, "RulesFileName");
-            lang[section.first].toplevelcmakefilename = basedir / cfg.get_value(section.first, "TopLevelCMakeFileName");
-            lang[section.first].srclevelcmakefilename = basedir / cfg.get_value(section.first, "SrcLevelCMakeFileName");
-            if (cfg.has_value(section.first, "CloneDir")) {
-                lang[section.first].clonedir = cfg.get_value(section.first, "CloneDir");
+static constexpr std::string_view usage{"Usage: autoproject [--profile name] [--output-root dir] [--fanout n] [--ninja] [--compile-commands] [--perf-harness] project.md...\n"
+    "Creates a CMake build tree under 'project' subdirectory for each file\n"
+    "With --profile lean, leaves out the documentation directory and targets\n"
+    "With --output-root dir [--fanout n], puts each project under 'dir' and n levels\n"
+    "   of subdirectories named from a hash of the project name\n"
+    "With --ninja, also writes a build.ninja which needs no configure step\n"
+    "With --compile-commands, also writes a compile_commands.json for clangd and clang-tidy\n"
+    "With --perf-harness, also adds an optimized build and a 'perf' target to time it\n"
+    "   or: autoproject --superbuild dir project.md...\n"
+    "Creates the projects under 'dir' with a CMakeLists.txt there which builds them all\n"
+    "   or: autoproject --check[=n] project.md...\n"
+    "Creates each project, then checks its syntax with at most n compilers at once\n"
+    "   or: autoproject --shard K/N project.md...\n"
+    "Creates only the projects in shard K of N and writes a status file for the shard\n"
+    "   or: autoproject --merge-status file.status...\n"
+    "Combines the status files of every shard into one report\n"
+    "   or: autoproject --profile-rules corpusdir\n"
+    "Times every rule against the code in each .md file in 'corpusdir'\n"
+    "   or: autoproject --watch dir [--jobs n]\n"
+    "Creates a CMake build tree for each .md file written to 'dir'\n"
+    "   or: autoproject --native-host\n"
+    "Serves the autodownload browser extension via native messaging\n"};
+
+static Watcher *activeWatcher{nullptr};
+
+extern "C" void stopWatching(int) {
+    if (activeWatcher) {
+        activeWatcher->stop();
+    }
+}
+
+// extract every .md file that arrives in `dir` until interrupted
+static int watch(const std::string& dir, const std::string& jobs, const ConfigFile& cfg, 
+        std::shared_ptr<ConfigStore> config, bool overwrite) 
+{
+    WatchOptions options;
+    options.overwrite = overwrite;
+    try {
+        if (!jobs.empty()) {
+            options.workers = static_cast<unsigned>(std::stoul(jobs));
+        }
+        if (cfg.has_value("General", "WatchQueueDepth")) {
+            options.queueDepth = std::stoul(cfg.get_value("General", "WatchQueueDepth"));
+        }
+        auto async{cfg.get_value("General", "AsyncOutput")};
+        options.asyncOutput = async == "true" || async == "TRUE" || async == "True";
+        if (cfg.has_value("General", "WatchDebounceMs")) {
+            options.debounce = std::chrono::milliseconds{std::stoul(cfg.get_value("General", "WatchDebounceMs"))};
+        }
+        if (cfg.has_value("General", "ConfigReloadMs")) {
+            options.reload = std::chrono::milliseconds{std::stoul(cfg.get_value("General", "ConfigReloadMs"))};
+        }
+        Watcher watcher{dir, config, options, std::cout};
+        activeWatcher = &watcher;
+        std::signal(SIGINT, stopWatching);
+        std::signal(SIGTERM, stopWatching);
+        std::cout << "Watching " << dir << " with " << options.workers << " workers\n" << std::flush;
+        watcher.run();
+        activeWatcher = nullptr;
+        std::cout << "Extracted " << watcher.extracted() << " projects\n";
+    }
+    catch(const std::exception& e) {
+        activeWatcher = nullptr;
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+// write build.ninja next to the top level CMakeLists.txt
+static void writeNinja(const AutoProject& ap) {
+    auto info{ap.buildInfo()};
+    std::ofstream ninja{info.outdir / "build.ninja"};
+    writeNinjaFile(ninja, info);
+    if (!ninja) {
+        throw std::runtime_error("Cannot write " + (info.outdir / "build.ninja").string());
+    }
+}
+
+// write compile_commands.json next to the top level CMakeLists.txt
+static void writeCompileDatabase(const AutoProject& ap) {
+    auto info{ap.buildInfo()};
+    std::ofstream commands{info.outdir / "compile_commands.json"};
+    writeCompileCommands(commands, info);
+    if (!commands) {
+        throw std::runtime_error("Cannot write " + (info.outdir / "compile_commands.json").string());
+    }
+}
+
+struct BatchOptions {
+    bool overwrite{false};
+    bool ninja{false};
+    bool compileCommands{false};
+    bool perfHarness{false};
+    // write with io_uring where available
+    bool asyncOutput{false};
+    // compile each project's sources with -fsyntax-only afterwards
+    bool check{false};
+    std::string checkjobs;
+    ExtractionLimits limits;
+    OutputLayout layout;
+    // if set, extract only this shard's files and write its status file
+    std::optional<Shard> shard;
+    // if set, write a CMakeLists.txt here which builds every project
+    fs::path superbuild;
+};
+
+// write the superbuild's CMakeLists.txt, which adds each of `projects`
+static void writeSuperbuildFile(const fs::path& dir, const std::vector<BuildInfo>& projects) {
+    fs::create_directories(dir);
+    std::ofstream cmake{dir / "CMakeLists.txt"};
+    writeSuperbuild(cmake, dir, projects);
+    if (!cmake) {
+        throw std::runtime_error("Cannot write " + (dir / "CMakeLists.txt").string());
+    }
+}
+
+/*
+ * Extract each file into memory and write the files of many projects at
+ * once, then optionally check the syntax of every project.  A failure 
+ * only affects the project (or the batch being written) concerned.
+ * Every extraction reuses one arena, so memory stays flat however many
+ * files there are.
+ */
+static int batch(std::span<char *> mdfiles, std::map<std::string, LangConfig>& lang, const BatchOptions& options) {
+    static constexpr std::size_t flushBytes{16 * 1024 * 1024};
+    static constexpr std::size_t arenaSize{256 * 1024};
+    unsigned n{0};
+    try {
+        if (!options.checkjobs.empty()) {
+            n = static_cast<unsigned>(std::stoul(options.checkjobs));
+        }
+    }
+    catch(const std::exception& e) {
+        std::cerr << "Error: bad job count \"" << options.checkjobs << "\"\n";
+        return 1;
+    }
+    SyntaxChecker checker{n};
+    auto writer{OutputWriter::create(options.asyncOutput)};
+    OutputBatch output;
+    // status and build information for each project in `output`
+    std::vector<std::string> statuses;
+    std::vector<BuildInfo> projects;
+    std::set<fs::path> outdirs;
+    // every project written, and the target names given out, for a superbuild
+    std::vector<BuildInfo> superbuild;
+    std::set<std::string> targets;
+    std::size_t overLimit{0};
+    std::size_t files{0};
+    // the outcome of every file, once known, and of those in `output`
+    ShardStatus shardStatus{options.shard.value_or(Shard{})};
+    std::vector<StatusRecord> pending;
+    std::vector<std::byte> buffer(arenaSize);
+    std::pmr::monotonic_buffer_resource arena{buffer.data(), buffer.size()};
+    int status{0};
+    auto flush = [&]{
+        try {
+            writer->write(output);
+            for (std::size_t i{0}; i < projects.size(); ++i) {
+                std::cout << statuses[i];
+                checker.add(projects[i]);
+            }
+            if (!options.superbuild.empty()) {
+                superbuild.insert(superbuild.end(), projects.begin(), projects.end());
+            }
+        }
+        catch(const std::exception& e) {
+            std::cerr << "Error: " << e.what() << '\n';
+            status = 1;
+            for (auto& record : pending) {
+                record.result = "error";
+                record.message = e.what();
             }
         }
+        std::move(pending.begin(), pending.end(), std::back_inserter(shardStatus.records));
+        output.clear();
+        statuses.clear();
+        projects.clear();
+        pending.clear();
+    };
+    for (const auto mdfile : mdfiles) {
+        StatusRecord record{"error", fs::path{mdfile}.stem().string(), mdfile, {}};
+        if (options.shard && !options.shard->contains(record.projname)) {
+            continue;
+        }
+        ++files;
+        try {
+            AutoProject ap{mdfile, lang, &arena};
+            ap.setLimits(options.limits);
+            ap.setOutputLayout(options.layout);
+            ap.setPerfHarness(options.perfHarness);
+            if (!options.superbuild.empty()) {
+                ap.setTargetName(uniqueTargetName(record.projname, targets));
+            }
+            OutputBatch project;
+            if (ap.createProject(options.overwrite, project)) {
+                auto info{ap.buildInfo()};
+                // nothing of an earlier project in this batch is on disk yet
+                if (!outdirs.insert(info.outdir).second && !options.overwrite) {
+                    throw std::runtime_error(info.outdir.string() + " already exists: will not overwrite.");
+                }
+                if (options.ninja) {
+                    std::ostringstream ninja;
+                    writeNinjaFile(ninja, info);
+                    project.file(info.outdir / "build.ninja") = std::move(ninja).str();
+                }
+                if (options.compileCommands) {
+                    std::ostringstream commands;
+                    writeCompileCommands(commands, info);
+                    project.file(info.outdir / "compile_commands.json") = std::move(commands).str();
+                }
+                output.append(std::move(project));
+                std::ostringstream msg;
+                msg << ap;
+                statuses.push_back(std::move(msg).str());
+                record.result = "ok";
+                for (const auto& source : info.sources) {
+                    record.message.append(record.message.empty() ? "" : " ").append(source.filename().string());
+                }
+                pending.push_back(std::move(record));
+                projects.push_back(std::move(info));
+            } else {
+                std::cerr << "Error: no source files found in " << mdfile << '\n';
+                record.result = "empty";
+                record.message = "no source files found";
+                shardStatus.records.push_back(std::move(record));
+                status = 1;
+            }
+        }
+        catch(const LimitExceeded& e) {
+            // nothing of this project is in `output`, so the rest carry on
+            std::cerr << "Error: " << mdfile << ": " << e.what() << '\n';
+            record.result = "limit";
+            record.message = e.what();
+            shardStatus.records.push_back(std::move(record));
+            ++overLimit;
+            status = 1;
+        }
+        catch(const std::exception& e) {
+            std::cerr << "Error: " << mdfile << ": " << e.what() << '\n';
+            record.message = e.what();
+            shardStatus.records.push_back(std::move(record));
+            status = 1;
+        }
+        // the project, and everything it allocated, is gone
+        arena.release();
+        if (output.bytes() >= flushBytes) {
+            flush();
+        }
+    }
+    flush();
+    if (overLimit) {
+        std::cerr << overLimit << " of " << files << " files skipped for exceeding limits\n";
+    }
+    if (options.shard) {
+        const auto filename{options.shard->statusFilename()};
+        std::ofstream statusfile{filename};
+        writeStatus(statusfile, shardStatus);
+        if (!statusfile) {
+            std::cerr << "Error: cannot write " << filename << '\n';
+            status = 1;
+        }
+        std::cout << "Shard " << options.shard->index << '/' << options.shard->count << ": " 
+            << files << " of " << mdfiles.size() << " files; wrote " << filename << '\n';
     }
-    return lang;
+    if (!options.superbuild.empty()) {
+        try {
+            writeSuperbuildFile(options.superbuild, superbuild);
+            std::cout << "Wrote a superbuild of " << superbuild.size() << " projects to " << options.superbuild << '\n';
+        }
+        catch(const std::exception& e) {
+            std::cerr << "Error: " << e.what() << '\n';
+            status = 1;
+        }
+    }
+    if (options.check && reportCheck(std::cout, checker.run())) {
+        status = 1;
+    }
+    return status;
+}
+
+// time every rule over a corpus, writing a table to stdout and JSON to a file
+static int profileRules(const std::string& dir, std::map<std::string, LangConfig>& lang) {
+    static const std::string jsonfilename{"rule-profile.json"};
+    try {
+        RuleProfiler profiler{lang};
+        auto files{profiler.profileDirectory(dir)};
+        auto stats{profiler.results()};
+        writeProfileTable(std::cout, stats);
+        std::ofstream json{jsonfilename};
+        writeProfileJson(json, stats);
+        std::cout << "Profiled " << stats.size() << " rules over " << files << " files; wrote " << jsonfilename << '\n';
+    }
+    catch(const std::exception& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+// serve native messaging requests from the browser extension on stdin/stdout
+static int nativeHost(std::streambuf *protocol, std::shared_ptr<ConfigStore> config, bool overwrite) {
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    const char *dir{std::getenv("AUTOPROJECT_DIR")};
+    std::ostream replies{protocol};
+    NativeHost host{std::cin, replies, config, dir ? dir : "/tmp", overwrite};
+    auto projects{host.run()};
+    std::cerr << "Extracted " << projects << " projects\n";
+    return 0;
 }
 
 int main(int argc, char *argv[]) {
+    // The browser starts a native messaging host with the extension's ID
+    // (Firefox) or origin (Chrome) as an argument.  Because stdout then 
+    // carries the protocol, all other output is diverted to stderr.
+    bool nativeHostMode{false};
+    for (int i=1; i < argc; ++i) {
+        std::string_view arg{argv[i]};
+        if (arg == "--native-host" || arg == extensionId || arg.starts_with("chrome-extension://")) {
+            nativeHostMode = true;
+        }
+    }
+    std::streambuf *protocol{std::cout.rdbuf()};
+    if (nativeHostMode) {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+
     std::string configfile{defaultconfigfilename};
+    std::string watchdir;
+    std::string jobs;
+    std::string corpusdir;
+    bool syntaxCheck{false};
+    std::string checkjobs;
+    std::string shard;
+    std::string profile;
+    std::string outputRoot;
+    std::string fanout;
+    std::string superbuild;
+    bool mergeStatusFiles{false};
 
     struct {
         std::string configfiledir;
         bool forceOverwrite = false;
+        bool pipeline = false;
+        bool ninja = false;
+        bool compileCommands = false;
+        bool perfHarness = false;
         bool license = false;
         bool help = false;
         bool version = false;
@@ -71,22 +417,37 @@ int main(int argc, char *argv[]) {
     // handle command line arguments
     std::map<std::string, bool&> boolargs{
         { "--forceoverwrite", configuration.forceOverwrite },
+        { "--pipeline", configuration.pipeline },
+        { "--ninja", configuration.ninja },
+        { "--compile-commands", configuration.compileCommands },
+        { "--perf-harness", configuration.perfHarness },
         { "--license", configuration.license },
         { "--help", configuration.help },
         { "--version", configuration.version },
+        { "--merge-status", mergeStatusFiles },
     };
     // TODO: use this to allow override of configuration file
     std::map<std::string, std::string&> stringargs{
         { "--configfile", configfile},
+        { "--watch", watchdir},
+        { "--jobs", jobs},
+        { "--profile-rules", corpusdir},
+        { "--shard", shard},
+        { "--profile", profile},
+        { "--output-root", outputRoot},
+        { "--fanout", fanout},
+        { "--superbuild", superbuild},
     };
     std::map<std::string, std::string> shortboolargs{
         { "-f", "--forceoverwrite" },
+        { "-p", "--pipeline" },
         { "-L", "--license" },
         { "-h", "--help" },
         { "-v", "--version" },
     };
     std::map<std::string, std::string> shortstringargs{
         { "-c", "--configfile" },
+        { "-j", "--jobs" },
     };
     // TODO: make a more rational system for command line args
     // Specifically, command line args should override config file.
@@ -94,6 +455,14 @@ int main(int argc, char *argv[]) {
     int processed_args{0};
     for (int i=1; i < argc; ++i) {
         // std::cout << "argv[" << i << "] = " << argv[i] << ", processed_args = " << processed_args << '\n';
+        // --check takes an optional job count, so it can't be a string arg
+        if (std::string_view arg{argv[i]}; arg == "--check" || arg.starts_with("--check=")) {
+            std::cout << "Found option --check\n";
+            syntaxCheck = true;
+            checkjobs = arg.substr(std::min(arg.size(), sizeof "--check"));
+            ++processed_args;
+            continue;
+        }
         auto option = boolargs.find(argv[i]);
         if (option != boolargs.end()) {
             std::cout << "Found option " << option->first << '\n';
@@ -118,7 +487,7 @@ int main(int argc, char *argv[]) {
 
         auto shortstroption = shortstringargs.find(argv[i]);
         if (shortstroption != shortstringargs.end()) {
-            std::cout << "Found option " << shortoption->first << '\n';
+            std::cout << "Found option " << shortstroption->first << '\n';
             stroption = stringargs.find(shortstroption->second);
             stroption->second = argv[++i];
             processed_args += 2;
@@ -135,15 +504,26 @@ int main(int argc, char *argv[]) {
         std::cout << version << '\n'; 
         return 0;
     }
+    if (mergeStatusFiles) {
+        try {
+            const std::vector<fs::path> statusfiles(argv + processed_args + 1, argv + argc);
+            return mergeStatus(std::cout, statusfiles);
+        }
+        catch(const std::exception& e) {
+            std::cerr << "Error: " << e.what() << '\n';
+            return 1;
+        }
+    }
+    // without an installed configuration file, the built-in defaults are used
     std::ifstream config{configfile};
-    if (!config) {
+    if (!config && configfile != defaultconfigfilename) {
         std::cerr << "Error: cannot open input configuration file \"" << configfile << "\"\n";
         return 1;
     }
     ConfigFile cfg{config};
 
     auto reportedVersion{cfg.get_value("General", "Version")};
-    if (reportedVersion != std::to_string(VERSION_MAJOR)) {
+    if (config && reportedVersion != std::to_string(VERSION_MAJOR)) {
         std::cerr << "Error: version in " << configfile << "\nreports that the config file is version \"" << reportedVersion << "\" but this program is version \"" << VERSION_MAJOR << "\"\n";
     } else if (!configuration.forceOverwrite) {
         auto over{cfg.get_value("General", "ForceOverwrite")};
@@ -151,8 +531,81 @@ int main(int argc, char *argv[]) {
             configuration.forceOverwrite = true;
         }
     }
-    configuration.lang = fetchLanguageSettings(cfg);
+    if (auto commands{cfg.get_value("General", "CompileCommands")}; 
+            commands == "true" || commands == "TRUE" || commands == "True") {
+        configuration.compileCommands = true;
+    }
+    // the command line overrides the configuration file, including when it is reloaded
+    auto commandLine = [&](ConfigFile& settings) {
+        if (!profile.empty()) {
+            settings.set_value("General", "Profile", profile);
+        }
+        if (!outputRoot.empty()) {
+            settings.set_value("General", "OutputRoot", outputRoot);
+        }
+        if (!fanout.empty()) {
+            settings.set_value("General", "OutputFanout", fanout);
+        }
+    };
+    commandLine(cfg);
+    ExtractionLimits limits;
+    OutputLayout layout;
+    // the processes which keep running reload the configuration when it changes
+    std::shared_ptr<ConfigStore> store;
+    try {
+        if (nativeHostMode || !watchdir.empty()) {
+            store = std::make_shared<ConfigStore>(configfile, commandLine);
+        } else {
+            configuration.lang = fetchLanguageSettings(cfg, cfg.get_value("General", "Profile"));
+            limits = fetchExtractionLimits(cfg);
+            layout = fetchOutputLayout(cfg);
+        }
+    }
+    catch(const std::exception& e) {
+        std::cerr << "Error: " << configfile << ": " << e.what() << '\n';
+        return 1;
+    }
 
+    if (nativeHostMode) {
+        int status{nativeHost(protocol, store, configuration.forceOverwrite)};
+        std::cout.rdbuf(protocol);
+        return status;
+    }
+    if (!corpusdir.empty()) {
+        return profileRules(corpusdir, configuration.lang);
+    }
+    if (!watchdir.empty()) {
+        return watch(watchdir, jobs, cfg, store, configuration.forceOverwrite);
+    }
+
+    if (argc - processed_args > 2 || ((syntaxCheck || !shard.empty() || !superbuild.empty()) && argc - processed_args == 2)) {
+        BatchOptions options;
+        if (!shard.empty()) {
+            try {
+                options.shard = Shard::parse(shard);
+            }
+            catch(const std::exception& e) {
+                std::cerr << "Error: " << e.what() << '\n';
+                return 1;
+            }
+        }
+        options.overwrite = configuration.forceOverwrite;
+        options.ninja = configuration.ninja;
+        options.compileCommands = configuration.compileCommands;
+        options.perfHarness = configuration.perfHarness;
+        auto async{cfg.get_value("General", "AsyncOutput")};
+        options.asyncOutput = async == "true" || async == "TRUE" || async == "True";
+        options.check = syntaxCheck;
+        options.checkjobs = checkjobs;
+        options.limits = limits;
+        options.layout = layout;
+        options.superbuild = superbuild;
+        // the projects go in the superbuild's directory unless told otherwise
+        if (!superbuild.empty() && options.layout.root.empty()) {
+            options.layout.root = superbuild;
+        }
+        return batch({argv + processed_args + 1, argv + argc}, configuration.lang, options);
+    }
     if (argc - processed_args != 2) {
         std::cerr << usage; 
         for (int i=processed_args+1; i < argc; ++i) {
@@ -163,13 +616,22 @@ int main(int argc, char *argv[]) {
     AutoProject ap;
     try {
         ap.open(argv[processed_args + 1], configuration.lang);
+        ap.setLimits(limits);
+        ap.setOutputLayout(layout);
+        ap.setPerfHarness(configuration.perfHarness);
     }
     catch(const std::exception& e) {
         std::cerr << "Error: " << e.what() << '\n';
         return 1;
     }
     try {
-        if (ap.createProject(configuration.forceOverwrite)) {
+        if (ap.createProject(configuration.forceOverwrite, configuration.pipeline)) {
+            if (configuration.ninja) {
+                writeNinja(ap);
+            }
+            if (configuration.compileCommands) {
+                writeCompileDatabase(ap);
+            }
             std::cout << ap;   // print final status
         }
     }
@@ -1,5 +1,21 @@
 #include "AutoProject.h"
+#include "CompileCommands.h"
+#include "CompilerCache.h"
+#include "Json.h"
+#include "NinjaFile.h"
+#include "RuleProfiler.h"
+#include "ShardStatus.h"
+#include "Superbuild.h"
+#include "SyntaxCheck.h"
+#include "TempDir.h"
 #include "trim.h"
+#include <cstdlib>
+#include <fstream>
+#include <memory_resource>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
 #if USE_CATCH2_VERSION == 2
 #  define CATCH_CONFIG_MAIN
 #  include <catch2/catch.hpp>
@@ -79,3 +95,662 @@ TEST_CASE( "Project created from md file", "[autoproject]" ) {
     AutoProject ap;
     REQUIRE(!ap.createProject(false));
 }
+
+TEST_CASE( "Rules file lines are split into fields", "[rules]" ) {
+    static_assert(countRules("# comment @ only one\nabc@def@ghi@jkl@mno\n@x@y\nre@@lib") == 2);
+    constexpr auto rules{splitRules<2>("abc@def@ghi@jkl@mno\nre@@lib")};
+    REQUIRE(rules[0].regex == "abc");
+    REQUIRE(rules[0].cmake == "def");
+    REQUIRE(rules[0].libraries == "ghi");
+    REQUIRE(rules[0].flags == "jkl");
+    REQUIRE(rules[0].linkflags == "mno");
+    REQUIRE(rules[1].flags.empty());
+    REQUIRE(rules[1].cmake.empty());
+    REQUIRE(rules[1].libraries == "lib");
+    REQUIRE(rules[1].scope.empty());
+    // errors are reported against the line a rule came from
+    constexpr auto numbered{splitRules<2>("# comment\nabc@def@\n\nre@@lib")};
+    static_assert(numbered[0].line == 2 && numbered[1].line == 4);
+    constexpr auto scoped{splitRule("re@@lib@@-lx@directive")};
+    static_assert(scoped && scoped->linkflags == "-lx" && scoped->scope == "directive");
+    static_assert(parseRuleScope("") == RuleScope::any);
+    static_assert(parseRuleScope("code") == RuleScope::code);
+    static_assert(!parseRuleScope("comment"));
+}
+
+TEST_CASE( "Tokenizer follows comments, strings and directives", "[tokenizer]" ) {
+    // each line with its code and whether it is a directive
+    auto tokenize = [](SourceDialect dialect, std::initializer_list<std::string_view> lines) {
+        SourceTokenizer tokenizer{dialect};
+        std::vector<std::pair<std::string, bool>> result;
+        for (auto line : lines) {
+            auto tokens{tokenizer.next(line)};
+            REQUIRE(tokens.text == line);
+            result.emplace_back(tokens.code, tokens.directive);
+        }
+        return result;
+    };
+    using Lines = std::vector<std::pair<std::string, bool>>;
+
+    SECTION("Comments are removed and only real directives are found") {
+        REQUIRE(tokenize(SourceDialect::c, {
+            "#include <thread> // for std::thread",
+            "// #include <regex>",
+            "/* #include <future>",
+            "   #include <mutex> */ int x; /* y */ int z;",
+            "  /* leading */ #  include <vector>",
+            "int a; /* starts",
+            "   ends */ #include <not a directive>",
+        }) == Lines{
+            { "#include <thread>  ", true },
+            { " ", false },
+            { " ", false },
+            { "  int x;   int z;", false },
+            { "    #  include <vector>", true },
+            { "int a;  ", false },
+            { "  #include <not a directive>", false },
+        });
+    }
+
+    SECTION("Strings, characters and numbers hide what looks like comments") {
+        REQUIRE(tokenize(SourceDialect::c, {
+            "auto s{\"/* not a comment\"}; char c{'\"'};",
+            "auto big{1'000'000}; auto r{R\"x(// still a string",
+            "#include <thread> )\" not the end",
+            ")x\"}; // done",
+            "#define LONG \\",
+            "    #include <regex>",
+            "const char *unterminated = \"/*",
+            "#pragma once",
+        }) == Lines{
+            { "auto s{\"/* not a comment\"}; char c{'\"'};", false },
+            { "auto big{1'000'000}; auto r{R\"x(// still a string", false },
+            { "#include <thread> )\" not the end", false },
+            { ")x\"};  ", false },
+            { "#define LONG \\", true },
+            { "    #include <regex>", true },
+            { "const char *unterminated = \"/*", false },
+            { "#pragma once", true },
+        });
+    }
+
+    SECTION("NASM has its own comments and directives") {
+        REQUIRE(tokenize(SourceDialect::nasm, {
+            "%include \"macros.inc\" ; helpers",
+            "    mov eax, ';'   ; int 0x80",
+            "    db `a\\`;b`, 0",
+        }) == Lines{
+            { "%include \"macros.inc\"  ", true },
+            { "    mov eax, ';'    ", false },
+            { "    db `a\\`;b`, 0", false },
+        });
+    }
+
+    SECTION("Rules only fire within their scope") {
+        auto lang{builtinLanguageSettings()};
+        AutoProject ap{"commented.md", "### tags: ['c++']\n\n"
+            "    // #include <thread>\n"
+            "    /* #include <filesystem>\n"
+            "       */ #include <regex>\n"
+            "    const char *s{\"#include <future>\"};\n"
+            "    #include <mutex>\n"
+            "    int main() {}\n", lang};
+        OutputBatch batch;
+        REQUIRE(ap.createProject(false, batch));
+        REQUIRE(ap.buildInfo().flags == "-std=c++20 -pthread");
+        REQUIRE(ap.buildInfo().libraries == std::vector<std::string>{"${CMAKE_THREAD_LIBS_INIT}"});
+    }
+}
+
+TEST_CASE( "Templates replace only known placeholders", "[template]" ) {
+    Template t{std::string{"project({projname})\nset(X ${Y}) {unknown}\nadd_executable({projname} {srcnames})"}};
+    std::stringstream out;
+    t.render(out, {{ "projname", "248232" }, { "srcnames", " main.cpp" }});
+    REQUIRE(out.str() == "project(248232)\nset(X ${Y}) {unknown}\nadd_executable(248232  main.cpp)\n");
+
+    // a line of placeholders without values is left out, but not one with an empty value
+    Template optional{std::string{"project({projname})\n{launcher}\n{extras}\nadd_subdirectory(src)\n{clonedir}\n{harness}\n"}};
+    out.str("");
+    optional.render(out, {{ "projname", "248232" }, { "extras", "" }});
+    REQUIRE(out.str() == "project(248232)\n\nadd_subdirectory(src)\n");
+    out.str("");
+    optional.render(out, {{ "projname", "248232" }, { "extras", "" }, { "harness", "add_subdirectory(perf)" }});
+    REQUIRE(out.str() == "project(248232)\n\nadd_subdirectory(src)\nadd_subdirectory(perf)\n");
+}
+
+TEST_CASE( "Built-in configuration covers the shipped languages", "[builtin]" ) {
+    auto lang{builtinLanguageSettings()};
+    for (const auto name : {"c++", "c", "asm"}) {
+        REQUIRE(lang.contains(name));
+        REQUIRE(lang[name].builtin);
+        loadLanguage(lang[name]);
+        REQUIRE(!lang[name].rules->empty());
+    }
+    REQUIRE(!lang["c++"].clonefiles.empty());
+    REQUIRE(lang["asm"].clonefiles.empty());
+
+    SECTION("Configuration file values override the defaults") {
+        std::stringstream ss{"[General]\nConfigFileDir=/nowhere\n[c++]\nSubdir=cpp\nRulesFileName=myrules.txt\n"};
+        auto merged{fetchLanguageSettings(ConfigFile{ss})};
+        REQUIRE(merged["c++"].rulesfilename == fs::path{"/nowhere/cpp/myrules.txt"});
+        REQUIRE(merged["c++"].toplevelcmakefilename.empty());
+        REQUIRE(merged["c++"].clonefiles.empty());
+        REQUIRE(merged["c"].clonefiles.size() == lang["c"].clonefiles.size());
+    }
+}
+
+TEST_CASE( "Profiles apply their sections over the language settings", "[profile]" ) {
+    std::stringstream ss{"[General]\nConfigFileDir=/nowhere\n"
+        "[c++]\nCompileFlags=-std=c++20\n"
+        "[c++.fast]\nCompileFlags=-std=c++20 -O2\n[c.lean]\nCloneDir=docs\n"};
+    const ConfigFile cfg{ss};
+    auto full{fetchLanguageSettings(cfg, "full")};
+    REQUIRE(full["c++"].clonedir == "doc");
+    REQUIRE(full["c++"].compileflags == "-std=c++20");
+    auto fast{fetchLanguageSettings(cfg, "fast")};
+    REQUIRE(fast["c++"].compileflags == "-std=c++20 -O2");
+    REQUIRE(fast["c++"].clonedir == "doc");
+    // the configuration file's sections come after the built-in ones
+    auto lean{fetchLanguageSettings(cfg, "lean")};
+    REQUIRE(lean["c++"].clonedir.empty());
+    REQUIRE(lean["c"].clonedir == "docs");
+    REQUIRE(!lean.contains("c++.lean"));
+    REQUIRE_THROWS_WITH(fetchLanguageSettings(cfg, "tiny"), "unknown profile \"tiny\"");
+
+    // an overlay without Subdir keeps the directory of a language that isn't built in
+    std::stringstream custom{"[General]\nConfigFileDir=/cfg\n"
+        "[rust]\nSubdir=rs\nRulesFileName=rules.txt\n[rust.lean]\nCloneDir=none\n"};
+    auto rust{fetchLanguageSettings(ConfigFile{custom}, "lean")};
+    REQUIRE(rust["rust"].configdir == "/cfg/rs");
+    REQUIRE(rust["rust"].rulesfilename == "/cfg/rs/rules.txt");
+    REQUIRE(rust["rust"].clonedir.empty());
+
+    const TempDir temp{"overlay"};
+    const fs::path& dir{temp.path()};
+    std::ofstream{dir / "lean.md"} << "### tags: ['c++']\n\n**main.cpp**\n\n    int main() {}\n";
+    AutoProject ap{dir / "lean.md", lean};
+    OutputBatch batch;
+    REQUIRE(ap.createProject(false, batch));
+    for (const auto& file : batch.files()) {
+        INFO(file.path);
+        REQUIRE(file.path.parent_path().filename() != "doc");
+        if (file.path == dir / "lean" / "CMakeLists.txt") {
+            REQUIRE(file.contents.find("add_subdirectory(src)") != std::string::npos);
+            REQUIRE(file.contents.find("doc") == std::string::npos);
+        }
+    }
+}
+
+TEST_CASE( "Output layout fans projects out by a hash of the name", "[layout]" ) {
+    OutputLayout layout;
+    REQUIRE(layout.directory("/tmp/md/248232.md") == fs::path{"/tmp/md/248232"});
+    REQUIRE(layout.directory("248232.md") == fs::path{"248232"});
+    layout.root = "/srv/out";
+    REQUIRE(layout.directory("/tmp/md/248232.md") == fs::path{"/srv/out/248232"});
+    // the mapping is fixed so that other tools can compute it
+    layout.levels = 2;
+    REQUIRE(layout.directory("/tmp/md/248232.md") == fs::path{"/srv/out/fa/a9/248232"});
+    layout.levels = OutputLayout::maxLevels;
+    REQUIRE(layout.directory("248232.md") == fs::path{"/srv/out/fa/a9/02/f7/72/ef/22/e4/248232"});
+
+    std::stringstream ss{"[General]\nOutputRoot=/srv/out\nOutputFanout=3\n"};
+    auto fetched{fetchOutputLayout(ConfigFile{ss})};
+    REQUIRE(fetched.root == fs::path{"/srv/out"});
+    REQUIRE(fetched.levels == 3);
+    std::stringstream deep{"[General]\nOutputFanout=9\n"};
+    REQUIRE_THROWS(fetchOutputLayout(ConfigFile{deep}));
+
+    const TempDir temp{"layout"};
+    const fs::path& dir{temp.path()};
+    fs::create_directories(dir / "in");
+    std::ofstream{dir / "in" / "248232.md"} << "### tags: ['c']\n\n**main.c**\n\n    int main(void) { return 0; }\n";
+    auto lang{builtinLanguageSettings()};
+    AutoProject ap{dir / "in" / "248232.md", lang};
+    ap.setOutputLayout({dir / "out", 2});
+    REQUIRE(ap.createProject(false));
+    REQUIRE(fs::exists(dir / "out" / "fa" / "a9" / "248232" / "src" / "main.c"));
+    REQUIRE(ap.buildInfo().outdir == dir / "out" / "fa" / "a9" / "248232");
+}
+
+static std::string slurp(const fs::path& filename) {
+    std::ifstream in{filename};
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+TEST_CASE( "Pipelined extraction matches direct extraction", "[pipeline]" ) {
+    const TempDir temp{"pipeline"};
+    const fs::path& dir{temp.path()};
+    std::stringstream md;
+    md << "# [Big](https://codereview.stackexchange.com/questions/2)\n### tags: ['c++']\n\n";
+    for (int file{0}; file < 10; ++file) {
+        // unnamed fenced blocks all go to main.cpp, so later ones replace earlier ones
+        md << (file % 3 ? "**util" + std::to_string(file) + ".h**\n" : "Some text\n") << "```c++\n";
+        if (file == 7) {
+            md << "#include <thread>\n";
+        }
+        for (int line{0}; line < 300; ++line) {
+            md << "int f" << file << '_' << line << "() { return " << line << "; }\n";
+        }
+        md << "```\n\nutil" << file << ".cpp\n\n    #include <filesystem>\n\tint g" << file << ";\n\n";
+    }
+    for (const auto subdir : {"direct", "pipelined"}) {
+        fs::create_directories(dir / subdir);
+        std::ofstream{dir / subdir / "big.md"} << md.str();
+    }
+    auto lang{builtinLanguageSettings()};
+    AutoProject direct{dir / "direct" / "big.md", lang};
+    AutoProject pipelined{dir / "pipelined" / "big.md", lang};
+    REQUIRE(direct.createProject(false));
+    REQUIRE(pipelined.createProject(false, true));
+    std::size_t count{0};
+    for (const auto& entry : fs::recursive_directory_iterator(dir / "direct")) {
+        if (entry.is_regular_file()) {
+            auto relative{fs::relative(entry.path(), dir / "direct")};
+            INFO(relative);
+            REQUIRE(slurp(entry.path()) == slurp(dir / "pipelined" / relative));
+            ++count;
+        }
+    }
+    REQUIRE(count > 10);
+    REQUIRE(slurp(dir / "direct" / "big" / "src" / "CMakeLists.txt").find("Threads") != std::string::npos);
+}
+
+TEST_CASE( "Per-project state comes from the supplied arena", "[arena]" ) {
+    const TempDir temp{"arena"};
+    const fs::path& dir{temp.path()};
+    std::ofstream{dir / "small.md"} << "### tags: ['c++']\n\n"
+        "**main.cpp**\n\n    #include <thread>\n    int main() {}\n\n"
+        "**util.h**\n\n    #include <filesystem>\n";
+    auto lang{builtinLanguageSettings()};
+    // with no upstream resource, any allocation beyond the buffer throws
+    std::vector<std::byte> buffer(64 * 1024);
+    std::pmr::monotonic_buffer_resource arena{buffer.data(), buffer.size(), std::pmr::null_memory_resource()};
+    for (int i{0}; i < 100; ++i) {
+        AutoProject ap{dir / "small.md", lang, &arena};
+        REQUIRE(ap.createProject(true));
+        std::stringstream status;
+        status << ap;
+        REQUIRE(status.str().ends_with("\"main.cpp\"\n\"util.h\"\n"));
+        arena.release();
+    }
+}
+
+TEST_CASE( "Performance harness is added only when asked for", "[harness]" ) {
+    const TempDir temp{"harness"};
+    const fs::path& dir{temp.path()};
+    std::ofstream{dir / "timed.md"} << "### tags: ['c']\n\n**main.c**\n\n    int main(void) { return 0; }\n";
+    auto lang{builtinLanguageSettings()};
+    REQUIRE(!lang["c"].harnessfiles.empty());
+    REQUIRE(lang["asm"].harnessdir.empty());
+    for (bool harness : {false, true}) {
+        INFO("harness " << harness);
+        AutoProject ap{dir / "timed.md", lang};
+        ap.setPerfHarness(harness);
+        OutputBatch batch;
+        REQUIRE(ap.createProject(false, batch));
+        const auto& files{batch.files()};
+        auto find = [&](const fs::path& name) {
+            return std::find_if(files.begin(), files.end(), [&](const OutputFile& f){ return f.path == name; });
+        };
+        auto top{find(dir / "timed" / "CMakeLists.txt")};
+        REQUIRE(top != files.end());
+        REQUIRE((top->contents.find("add_subdirectory(perf)") != std::string::npos) == harness);
+        REQUIRE((find(dir / "timed" / "perf" / "perfrun.c") != files.end()) == harness);
+        REQUIRE(find(dir / "timed" / "doc" / "CMakeLists.txt") != files.end());
+    }
+}
+
+TEST_CASE( "Syntax check compiles each translation unit", "[check]" ) {
+    const TempDir temp{"check"};
+    const fs::path& dir{temp.path()};
+    std::ofstream{dir / "good.md"} << "### tags: ['c++']\n\n"
+        "**util.h**\n\n    int util();\n\n"
+        "**main.cpp**\n\n    #include \"util.h\"\n    #include <thread>\n    int main() { return util(); }\n\n"
+        "**util.cpp**\n\n    #include \"util.h\"\n    int util() { return 0; }\n";
+    std::ofstream{dir / "bad.md"} << "### tags: ['c++']\n\n"
+        "**main.cpp**\n\n    int main() { return missing; }\n";
+    auto lang{builtinLanguageSettings()};
+    SyntaxChecker checker{2};
+    for (const auto name : {"good.md", "bad.md"}) {
+        AutoProject ap{dir / name, lang};
+        REQUIRE(ap.createProject(false));
+        auto info{ap.buildInfo()};
+        REQUIRE(info.lang == "c++");
+        checker.add(info);
+        if (info.projname == "good") {
+            REQUIRE(info.sources.size() == 3);
+            REQUIRE(info.flags == "-std=c++20 -pthread");
+        }
+    }
+    auto results{checker.run()};
+    REQUIRE(results.size() == 3);
+    REQUIRE(results[0].file.filename() == "main.cpp");
+    REQUIRE(results[0].status == 0);
+    REQUIRE(results[1].file.filename() == "util.cpp");
+    REQUIRE(results[1].status == 0);
+    REQUIRE(results[2].projname == "bad");
+    REQUIRE(results[2].status != 0);
+    REQUIRE(results[2].output.find("missing") != std::string::npos);
+    std::stringstream report;
+    REQUIRE(reportCheck(report, results) == 1);
+    REQUIRE(report.str().ends_with("Checked 2 projects: 1 passed, 1 failed\n"));
+}
+
+TEST_CASE( "Language is found from the tags header", "[tags]" ) {
+    const TempDir temp{"tag"};
+    const fs::path& dir{temp.path()};
+    const std::pair<std::string, std::string> cases[]{
+        { "['c++17', 'c']", "c++" },
+        { "['beginner', \"c\"]", "c" },
+        { "['assembly']", "asm" },
+        { "['objective-c', 'c#']", "" },
+    };
+    for (std::size_t i{0}; i < std::size(cases); ++i) {
+        std::ofstream{dir / ("tags" + std::to_string(i) + ".md")} << "### tags: " << cases[i].first << "\n\n"
+            "**main.h**\n\n    int x;\n";
+    }
+    // languages are loaded on first use, possibly by several threads at once
+    auto lang{builtinLanguageSettings()};
+    std::vector<std::string> found(std::size(cases));
+    std::vector<std::thread> threads;
+    for (std::size_t i{0}; i < std::size(cases); ++i) {
+        threads.emplace_back([&, i]{
+            AutoProject ap{dir / ("tags" + std::to_string(i) + ".md"), lang};
+            try {
+                ap.createProject(false);
+            }
+            catch (const std::runtime_error&) {
+                // without a language there is no template to write
+            }
+            found[i] = ap.buildInfo().lang;
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (std::size_t i{0}; i < std::size(cases); ++i) {
+        INFO(cases[i].first);
+        REQUIRE(found[i] == cases[i].second);
+    }
+    REQUIRE(lang["c++"].rules);
+    REQUIRE(lang["asm"].rules);
+}
+
+TEST_CASE( "Rule profiler finds slow and unused rules", "[profile]" ) {
+    const TempDir temp{"profile"};
+    const fs::path& dir{temp.path()};
+    std::ofstream md{dir / "corpus.md"};
+    md << "### tags: ['c++']\n\n**main.cpp**\n\n    #include <iostream>\n";
+    for (int i{0}; i < 200; ++i) {
+        md << "    int x" << i << ";\n";
+    }
+    // backtracks through every way of splitting the run of a's
+    md << "    " << std::string(22, 'a') << "\n    int main() {}\n";
+    md.close();
+    auto lang{builtinLanguageSettings()};
+    lang["c++"].rules = std::make_shared<const RuleSet>(RuleSet{
+        { "(a|aa)*b", "", "" },
+        { "#include", "", "", "", "", RuleScope::directive },
+        { "never matches", "", "" },
+    });
+    RuleProfiler profiler{lang};
+    REQUIRE(profiler.profileDirectory(dir) == 1);
+    auto stats{profiler.results()};
+    REQUIRE(stats.size() == 3);
+    REQUIRE(stats[0].lines == 203);
+    REQUIRE(stats[0].hits == 0);
+    REQUIRE(!stats[0].slow.empty());
+    REQUIRE(stats[0].slow.front().line.find("aaaa") != std::string::npos);
+    REQUIRE(stats[0].slow.size() <= RuleProfiler::slowLimit);
+    REQUIRE(stats[0].median <= stats[0].p99);
+    REQUIRE(stats[0].p99 <= stats[0].max);
+    REQUIRE(stats[1].lines == 1);
+    REQUIRE(stats[1].hits == 1);
+    REQUIRE(stats[2].pattern == "never matches");
+    std::stringstream table;
+    writeProfileTable(table, stats);
+    REQUIRE(table.str().find("never fired: c++ rule 2: never matches") != std::string::npos);
+    std::stringstream json;
+    writeProfileJson(json, stats);
+    REQUIRE(Json::parse(json.str()).asArray().size() == 3);
+}
+
+TEST_CASE( "Ninja file builds the extracted sources", "[ninja]" ) {
+    REQUIRE(ninjaEscape("a b:$c") == "a$ b$:$$c");
+    BuildInfo info;
+    info.projname = "248232";
+    info.outdir = "/tmp/248232";
+    info.srcdir = "/tmp/248232/src";
+    info.lang = "c++";
+    info.sources = { "/tmp/248232/src/main.cpp", "/tmp/248232/src/util.h", "/tmp/248232/src/my util.cpp" };
+    info.compiler = "c++";
+    info.flags = "-std=c++20 -pthread";
+    info.linker = "c++";
+    info.linkflags = "-pthread";
+    info.libraries = { "stdc++fs", "${CMAKE_THREAD_LIBS_INIT}", "sfml-window -lGL" };
+    std::stringstream ninja;
+    writeNinjaFile(ninja, info);
+    const auto text{ninja.str()};
+    INFO(text);
+    REQUIRE(text.find("\nflags = -std=c++20 -pthread\n") != std::string::npos);
+    REQUIRE(text.find("\nlibs = -lstdc++fs -lsfml-window -lGL\n") != std::string::npos);
+    REQUIRE(text.find("# left to CMake: ${CMAKE_THREAD_LIBS_INIT}\n") != std::string::npos);
+    REQUIRE(text.find("build build/main.cpp.o: compile src/main.cpp\n") != std::string::npos);
+    REQUIRE(text.find("build build/my$ util.cpp.o: compile src/my$ util.cpp\n") != std::string::npos);
+    REQUIRE(text.find("util.h") == std::string::npos);
+    REQUIRE(text.find("build build/248232: link build/main.cpp.o build/my$ util.cpp.o\n") != std::string::npos);
+    REQUIRE(text.ends_with("default build/248232\n"));
+}
+
+TEST_CASE( "Compilation database lists each translation unit", "[compile-commands]" ) {
+    BuildInfo info;
+    info.projname = "248232";
+    info.outdir = "/tmp/248232";
+    info.srcdir = "/tmp/248232/src";
+    info.lang = "c++";
+    info.sources = { "/tmp/248232/src/main.cpp", "/tmp/248232/src/util.h", "/tmp/248232/src/my \"util\".cpp" };
+    info.compiler = "c++";
+    info.launcher = "ccache";
+    info.flags = "-std=c++20  -pthread";
+    std::stringstream out;
+    writeCompileCommands(out, info);
+    INFO(out.str());
+    const auto db{Json::parse(out.str())};
+    REQUIRE(db.asArray().size() == 2);
+    const auto& entry{db.asArray()[1]};
+    REQUIRE(entry["directory"].asString() == "/tmp/248232");
+    REQUIRE(entry["file"].asString() == "/tmp/248232/src/my \"util\".cpp");
+    REQUIRE(entry["output"].asString() == "/tmp/248232/build/my \"util\".cpp.o");
+    std::vector<std::string> args;
+    for (const auto& arg : entry["arguments"].asArray()) {
+        args.push_back(arg.asString());
+    }
+    REQUIRE(args == std::vector<std::string>{"c++", "-std=c++20", "-pthread", "-I", "/tmp/248232/src", 
+            "-c", "/tmp/248232/src/my \"util\".cpp", "-o", "/tmp/248232/build/my \"util\".cpp.o"});
+}
+
+TEST_CASE( "Extraction stops at the first limit exceeded", "[limits]" ) {
+    const TempDir temp{"limit"};
+    const fs::path& dir{temp.path()};
+    auto lang{builtinLanguageSettings()};
+    const std::string header{"# [Limits](https://codereview.stackexchange.com/questions/1)\n"
+        "### tags: ['c++']\n\n"};
+    auto extract = [&](const std::string& name, const std::string& body, const ExtractionLimits& limits) {
+        std::ofstream{dir / (name + ".md")} << header << body;
+        AutoProject ap{dir / (name + ".md"), lang};
+        ap.setLimits(limits);
+        OutputBatch batch;
+        try {
+            ap.createProject(false, batch);
+        }
+        catch (const LimitExceeded& e) {
+            // the batch is abandoned, so nothing reaches the disk
+            return std::make_pair(e.limit(), e.line());
+        }
+        return std::make_pair(std::string{}, std::size_t{0});
+    };
+    const std::string twoFiles{"**a.cpp**\n\n    int a;\n\n**b.cpp**\n\n    int b;\n"};
+
+    ExtractionLimits limits;
+    REQUIRE(extract("none", twoFiles, limits).first.empty());
+    limits.maxInputBytes = header.size();
+    REQUIRE(extract("input", twoFiles, limits).first == "MaxInputBytes");
+    limits = {};
+    limits.maxLineLength = 100;
+    auto [limit, line]{extract("line", "    int x;\n    // " + std::string(200, 'x') + "\n", limits)};
+    REQUIRE(limit == "MaxLineLength");
+    REQUIRE(line == 5);
+    limits = {};
+    limits.maxOutputFiles = 1;
+    REQUIRE(extract("files", twoFiles, limits).first == "MaxOutputFiles");
+    limits = {};
+    limits.maxOutputBytes = 15;
+    REQUIRE(extract("bytes", twoFiles, limits).first.empty());
+    limits.maxOutputBytes = 14;
+    REQUIRE(extract("bytes2", twoFiles, limits).first == "MaxOutputBytes");
+    limits = {};
+    limits.timeout = std::chrono::milliseconds{1};
+    std::string longPost{"    #include <iostream>\n"};
+    for (int i{0}; i < 100000; ++i) {
+        longPost += "    std::cout << " + std::to_string(i) + " << '\\n';\n";
+    }
+    REQUIRE(extract("slow", longPost, limits).first == "ProjectTimeoutMs");
+    REQUIRE(!fs::exists(dir / "slow"));
+}
+
+TEST_CASE( "Shards partition projects by name", "[shard]" ) {
+    // FNV-1a test vectors, so shards agree across platforms and builds
+    REQUIRE(stableHash("") == 0xcbf29ce484222325u);
+    REQUIRE(stableHash("a") == 0xaf63dc4c8601ec8cu);
+    REQUIRE(stableHash("foobar") == 0x85944171f73967e8u);
+    for (std::size_t count{1}; count <= 5; ++count) {
+        for (int q{0}; q < 100; ++q) {
+            const auto name{std::to_string(248000 + q)};
+            int owners{0};
+            for (std::size_t index{1}; index <= count; ++index) {
+                owners += Shard{index, count}.contains(name);
+            }
+            REQUIRE(owners == 1);
+        }
+    }
+    REQUIRE(Shard::parse("2/4").index == 2);
+    REQUIRE(Shard::parse("2/4").statusFilename() == "autoproject-shard-2-of-4.status");
+    REQUIRE_THROWS(Shard::parse("0/4"));
+    REQUIRE_THROWS(Shard::parse("5/4"));
+    REQUIRE_THROWS(Shard::parse("2"));
+    REQUIRE_THROWS(Shard::parse("x/4"));
+}
+
+TEST_CASE( "Shard status files round trip and merge", "[shard]" ) {
+    const TempDir temp{"shard"};
+    const fs::path& dir{temp.path()};
+    const ShardStatus first{{1, 3}, {
+        {"ok", "100", "/q/100.md", "main.cpp util.h"},
+        {"error", "101", "/q/tab\there.md", "line one\nback\\slash"},
+    }};
+    std::stringstream text;
+    writeStatus(text, first);
+    auto copy{readStatus(text)};
+    REQUIRE(copy.shard.index == 1);
+    REQUIRE(copy.shard.count == 3);
+    REQUIRE(copy.records.size() == 2);
+    REQUIRE(copy.records[1].mdfile == "/q/tab\there.md");
+    REQUIRE(copy.records[1].message == "line one\nback\\slash");
+
+    std::ofstream{dir / "1.status"} << text.str();
+    {
+        std::ofstream second{dir / "2.status"};
+        writeStatus(second, {{2, 3}, {{"ok", "102", "/q/102.md", "main.c"}}});
+        std::ofstream third{dir / "3.status"};
+        writeStatus(third, {{3, 3}, {{"ok", "100", "/q/100.md", "main.cpp"}}});
+    }
+    std::ostringstream report;
+    const std::vector<fs::path> two{dir / "1.status", dir / "2.status"};
+    REQUIRE(mergeStatus(report, two) == 1);
+    REQUIRE(report.str().find("shard 3/3 is missing") != std::string::npos);
+    REQUIRE(report.str().find("error: 101") != std::string::npos);
+    report.str("");
+    const std::vector<fs::path> all{dir / "1.status", dir / "2.status", dir / "3.status"};
+    REQUIRE(mergeStatus(report, all) == 1);
+    REQUIRE(report.str().find("Shards: 3 of 3\nFiles: 3 (ok 2, error 1)\n") == 0);
+    REQUIRE(report.str().find("100 was extracted by shards 1 and 3") != std::string::npos);
+}
+
+TEST_CASE( "Compiler cache is set up as the compiler launcher", "[cache]" ) {
+    // opt-in, so that the projects written don't depend on this machine
+    REQUIRE(!findCompilerCache("", "/srv/cache"));
+    REQUIRE(!findCompilerCache("none", "/srv/cache"));
+    auto cache{findCompilerCache("/opt/bin/ccache", "/srv/cache")};
+    REQUIRE(cache.kind() == "ccache");
+    REQUIRE(cache.cmake("C CXX") == 
+        "set(CMAKE_C_COMPILER_LAUNCHER \"${CMAKE_COMMAND}\" -E env \"CCACHE_DIR=/srv/cache\" \"/opt/bin/ccache\")\n"
+        "set(CMAKE_CXX_COMPILER_LAUNCHER \"${CMAKE_COMMAND}\" -E env \"CCACHE_DIR=/srv/cache\" \"/opt/bin/ccache\")");
+    REQUIRE(cache.command() == "CCACHE_DIR='/srv/cache' '/opt/bin/ccache'");
+    REQUIRE(cache.cmake("").empty());
+    // a launcher with no known cache directory variable is used as it is
+    cache = findCompilerCache("/opt/bin/distcc", "/srv/cache");
+    REQUIRE(cache.cmake("CXX") == "set(CMAKE_CXX_COMPILER_LAUNCHER \"/opt/bin/distcc\")");
+}
+
+TEST_CASE( "Superbuild adds every project with its own target names", "[superbuild]" ) {
+    REQUIRE(cmakeTargetName("248232") == "248232");
+    REQUIRE(cmakeTargetName("my prog:2") == "my_prog_2");
+    REQUIRE(cmakeTargetName("test") == "test_");
+    std::set<std::string> used;
+    REQUIRE(uniqueTargetName("a b", used) == "a_b");
+    REQUIRE(uniqueTargetName("a_b", used) == "a_b_2");
+
+    const TempDir temp{"superbuild"};
+    const fs::path& dir{temp.path()};
+    fs::create_directories(dir / "cpp");
+    std::ofstream{dir / "cpp" / "rules.txt"} << "#include <thread>@find_package(Threads REQUIRED)@Threads::Threads\n"
+        "#include <nowhere.h>@find_package(AutoprojectNowhere REQUIRED)@AutoprojectNowhere::AutoprojectNowhere\n";
+    std::istringstream conf{"[General]\nConfigFileDir=" + dir.string() 
+        + "\n[c++]\nSubdir=cpp\nRulesFileName=rules.txt\nCloneDir=none\n"};
+    auto lang{fetchLanguageSettings(ConfigFile{conf})};
+    std::ofstream{dir / "248232.md"} << "### tags: ['c++']\n\n    #include <thread>\n    int main() { std::thread{[]{}}.join(); }\n";
+    std::ofstream{dir / "test.md"} << "### tags: ['c']\n\n    int main(void) { return 0; }\n";
+    std::ofstream{dir / "bad.md"} << "### tags: ['c++']\n\n    int main() { return missing; }\n";
+    std::ofstream{dir / "needs.md"} << "### tags: ['c++']\n\n    #include <nowhere.h>\n    int main() {}\n";
+    OutputLayout layout;
+    layout.root = dir / "sb";
+    layout.levels = 1;
+    std::vector<BuildInfo> projects;
+    used.clear();
+    for (const auto name : {"248232.md", "test.md", "bad.md", "needs.md"}) {
+        AutoProject ap{dir / name, lang};
+        ap.setOutputLayout(layout);
+        ap.setTargetName(uniqueTargetName(fs::path{name}.stem().string(), used));
+        REQUIRE(ap.createProject(false));
+        projects.push_back(ap.buildInfo());
+    }
+    REQUIRE(projects[1].target == "test_");
+    {
+        std::ofstream out{layout.root / "CMakeLists.txt"};
+        writeSuperbuild(out, layout.root, projects);
+    }
+    const auto cmakelists{slurp(layout.root / "CMakeLists.txt")};
+    const auto hashed{layout.directory(dir / "248232.md").lexically_relative(layout.root).generic_string()};
+    REQUIRE(cmakelists.find("autoproject_add(248232 \"" + hashed + "\" CXX)\n") != std::string::npos);
+    REQUIRE(cmakelists.find(" C)\n") != std::string::npos);
+    REQUIRE(cmakelists.find("ASM_NASM") == std::string::npos);
+
+#ifdef __linux__
+    // one configure step, and one failed or missing project doesn't stop the rest
+    const auto build{layout.root / "build"};
+    const std::string cmake{CMAKE_COMMAND};
+    REQUIRE(std::system((cmake + " -S " + layout.root.string() + " -B " + build.string() 
+            + " -G \"Unix Makefiles\" > " + (dir / "configure.log").string() + " 2>&1").c_str()) == 0);
+    const auto configured{slurp(dir / "configure.log")};
+    INFO(configured);
+    REQUIRE(configured.find("Leaving out needs: AutoprojectNowhere") != std::string::npos);
+    REQUIRE(std::system((cmake + " --build " + build.string() + " -- -k > " 
+            + (dir / "build.log").string() + " 2>&1").c_str()) != 0);
+    REQUIRE(fs::exists(build / "248232" / "src" / "248232"));
+    REQUIRE(fs::exists(build / "test_" / "src" / "test_"));
+    REQUIRE(!fs::exists(build / "bad" / "src" / "bad"));
+    REQUIRE(slurp(dir / "build.log").find("needs") == std::string::npos);
+#endif
+}
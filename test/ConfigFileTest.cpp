@@ -135,3 +135,11 @@ TEST_CASE("Configuration file can be opened, read, written, queried", "[configte
         REQUIRE(!cfg.has_value("protocol", "version"));
     }
 }
+
+TEST_CASE("Values which can't be parsed are ignored quickly", "[configtest]") {
+    // once took exponential time in the length of the first word
+    std::stringstream ss{"[general]\nbad = " + std::string(40, 'a') + "  b\ngood = two words\n"};
+    ConfigFile cfg{ss};
+    REQUIRE(!cfg.has_value("general", "bad"));
+    REQUIRE(cfg.get_value("general", "good") == "two words");
+}
@@ -0,0 +1,81 @@
+#include "NativeHost.h"
+#include "TempDir.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#if USE_CATCH2_VERSION == 2
+#  define CATCH_CONFIG_MAIN
+#  include <catch2/catch.hpp>
+#elif USE_CATCH2_VERSION == 3
+#  include <catch2/catch_test_macros.hpp>
+#else
+#  error "Catch2 version unknown"
+#endif
+
+static std::string slurp(const fs::path& filename) {
+    std::ifstream in{filename, std::ios::binary};
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+TEST_CASE("JSON values can be parsed and quoted", "[json]") {
+    auto doc{Json::parse(R"( {"id": 206499, "tags": ["c++", "c"], "s": "a\"b\\né😀", "ok": true, "none": null} )")};
+    REQUIRE(doc["id"].toString() == "206499");
+    REQUIRE(doc["tags"].asArray().size() == 2);
+    REQUIRE(doc["tags"].asArray()[0].asString() == "c++");
+    REQUIRE(doc["s"].asString() == "a\"b\\n\xc3\xa9\xf0\x9f\x98\x80");
+    REQUIRE(doc["ok"].asBool());
+    REQUIRE(doc["none"].isNull());
+    REQUIRE(doc["missing"].isNull());
+    REQUIRE(Json::parse(Json::quote("tab\there \"quoted\"\n")).asString() == "tab\there \"quoted\"\n");
+    REQUIRE_THROWS_AS(Json::parse("{\"unterminated\": [1, 2"), JsonError);
+    REQUIRE_THROWS_AS(Json::parse("[1] 2"), JsonError);
+    // nesting is limited, so a hostile message can't exhaust the stack
+    REQUIRE(Json::parse(std::string(256, '[') + std::string(256, ']')).asArray().size() == 1);
+    REQUIRE_THROWS_AS(Json::parse(std::string(257, '[') + std::string(257, ']')), JsonError);
+    REQUIRE_THROWS_AS(Json::parse(std::string(1 << 20, '[')), JsonError);
+}
+
+TEST_CASE("HTML character references are unescaped", "[nativehost]") {
+    REQUIRE(htmlUnescape("cout &lt;&lt; &quot;x&#39;s&quot; &amp;&amp; y &gt; 0") == "cout << \"x's\" && y > 0");
+    REQUIRE(htmlUnescape("&#x41;&#66;") == "AB");
+    REQUIRE(htmlUnescape("a & b; &unknown; &") == "a & b; &unknown; &");
+}
+
+TEST_CASE("Native messages are framed with a length", "[nativehost]") {
+    std::stringstream channel;
+    writeNativeMessage(channel, R"({"a":1})");
+    writeNativeMessage(channel, "[]");
+    REQUIRE(*readNativeMessage(channel) == R"({"a":1})");
+    REQUIRE(*readNativeMessage(channel) == "[]");
+    REQUIRE(!readNativeMessage(channel));
+    std::stringstream truncated{std::string{"\x10\0\0\0{}", 6}};
+    REQUIRE_THROWS(readNativeMessage(truncated));
+}
+
+TEST_CASE("Native host extracts a recorded question", "[nativehost]") {
+    const TempDir temp{"nativehost"};
+    const fs::path& dir{temp.path()};
+    const auto recorded{slurp("examples/nativehost.json")};
+    REQUIRE(!recorded.empty());
+    std::stringstream requests;
+    writeNativeMessage(requests, recorded);
+    writeNativeMessage(requests, R"({"title": "no id"})");
+    std::stringstream replies;
+    std::istringstream builtin;
+    NativeHost host{requests, replies, std::make_shared<ConfigStore>(ConfigFile{builtin}), dir, false};
+    REQUIRE(host.run() == 1);
+
+    auto first{Json::parse(*readNativeMessage(replies))};
+    REQUIRE(first["question_id"].toString() == "206499");
+    REQUIRE(first["status"].asString() == "ok");
+    auto second{Json::parse(*readNativeMessage(replies))};
+    REQUIRE(second["status"].asString() == "error");
+    REQUIRE(!readNativeMessage(replies));
+
+    // the same file fetchQ would have written
+    REQUIRE(slurp(dir / "206499.md") == slurp("examples/octal.md"));
+    REQUIRE(fs::exists(dir / "206499" / "src" / "main.cpp"));
+}
@@ -0,0 +1,36 @@
+#ifndef TEMPDIR_H
+#define TEMPDIR_H
+#include <filesystem>
+#include <random>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+/*! A new, empty directory for one test's files.
+ *
+ * It is removed, with everything in it, however the test ends, so a
+ * failed `REQUIRE` leaves nothing behind.  A random suffix keeps tests
+ * which share a `name`, or runs of the same test, from sharing it.
+ */
+class TempDir {
+public:
+    explicit TempDir(std::string_view name) {
+        std::random_device random;
+        do {
+            dir = fs::temp_directory_path() / ("autoproject_" + std::string{name} + "_" + std::to_string(random()));
+        } while (!fs::create_directories(dir));
+    }
+    ~TempDir() {
+        std::error_code ec;
+        fs::remove_all(dir, ec);
+    }
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+    const fs::path& path() const { return dir; }
+
+private:
+    fs::path dir;
+};
+#endif // TEMPDIR_H
@@ -0,0 +1,177 @@
+#include "OutputWriter.h"
+#include "TempDir.h"
+#include "Watcher.h"
+#include "WorkQueue.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <thread>
+#if USE_CATCH2_VERSION == 2
+#  define CATCH_CONFIG_MAIN
+#  include <catch2/catch.hpp>
+#elif USE_CATCH2_VERSION == 3
+#  include <catch2/catch_test_macros.hpp>
+#else
+#  error "Catch2 version unknown"
+#endif
+
+using namespace std::literals;
+
+TEST_CASE("Work queue is bounded and drains after close", "[workqueue]") {
+    WorkQueue<int> q{2};
+    REQUIRE(q.push(1));
+    REQUIRE(q.push(2));
+
+    SECTION("Full queue blocks the producer until a consumer pops") {
+        std::thread producer{[&q]{ q.push(3); }};
+        std::this_thread::sleep_for(50ms);
+        REQUIRE(q.size() == 2);
+        REQUIRE(*q.pop() == 1);
+        producer.join();
+        REQUIRE(q.size() == 2);
+    }
+
+    SECTION("Closed queue refuses pushes but delivers remaining items") {
+        q.close();
+        REQUIRE(!q.push(3));
+        REQUIRE(*q.pop() == 1);
+        REQUIRE(*q.pop() == 2);
+        REQUIRE(!q.pop());
+    }
+}
+
+TEST_CASE("Output writers create the same files", "[output]") {
+    const TempDir temp{"output"};
+    const fs::path& dir{temp.path()};
+    auto slurp = [](const fs::path& path) {
+        std::ifstream in{path, std::ios::binary};
+        return std::string{std::istreambuf_iterator<char>{in}, {}};
+    };
+    for (bool async : {false, true}) {
+        fs::remove_all(dir);
+        OutputBatch batch;
+        batch.directory(dir / "one" / "src");
+        batch.directory(dir / "two" / "deep" / "src");
+        batch.file(dir / "one" / "src" / "main.cpp") = "int main() {}\n";
+        batch.file(dir / "one" / "empty.txt");
+        batch.file(dir / "two" / "deep" / "src" / "a.c") = "first";
+        // a second write of the same file replaces the first
+        batch.file(dir / "two" / "deep" / "src" / "a.c") = "second";
+        REQUIRE(batch.files().size() == 3);
+        REQUIRE(batch.bytes() == 20);
+        auto writer{OutputWriter::create(async)};
+        writer->write(batch);
+        INFO("writer " << writer->name());
+        REQUIRE(slurp(dir / "one" / "src" / "main.cpp") == "int main() {}\n");
+        REQUIRE(fs::exists(dir / "one" / "empty.txt"));
+        REQUIRE(fs::file_size(dir / "one" / "empty.txt") == 0);
+        REQUIRE(slurp(dir / "two" / "deep" / "src" / "a.c") == "second");
+
+        OutputBatch missing;
+        missing.file(dir / "nowhere" / "x.txt") = "x";
+        // a failed file doesn't stop the rest of the batch being written
+        missing.file(dir / "one" / "after.txt") = "after";
+        REQUIRE_THROWS(writer->write(missing));
+        REQUIRE(slurp(dir / "one" / "after.txt") == "after");
+    }
+}
+
+TEST_CASE("Configuration snapshots are replaced when their files change", "[reload]") {
+    const TempDir temp{"reload"};
+    const fs::path& dir{temp.path()};
+    fs::create_directories(dir / "cpp");
+    const auto conffile{dir / "autoproject.conf"};
+    const auto rulesfile{dir / "cpp" / "rules.txt"};
+    // rewrite a file so that its modification time is sure to differ
+    auto rewrite = [](const fs::path& filename, const std::string& contents) {
+        const auto before{fs::exists(filename) ? fs::last_write_time(filename) : fs::file_time_type{}};
+        std::ofstream{filename} << contents;
+        fs::last_write_time(filename, std::max(fs::last_write_time(filename), before + 1s));
+    };
+    auto configuration = [&](const std::string& general) {
+        return "[General]\nConfigFileDir=" + dir.string() + "\n" + general 
+            + "[c++]\nSubdir=cpp\nRulesFileName=rules.txt\nCloneDir=none\n";
+    };
+    rewrite(conffile, configuration("MaxLineLength=100\n"));
+    rewrite(rulesfile, "#include <thread>@find_package(Threads REQUIRED)@Threads::Threads\n");
+    ConfigStore store{conffile, [](ConfigFile& cfg) { cfg.set_value("General", "OutputFanout", "1"); }};
+    const auto first{store.current()};
+    REQUIRE(first->version == 1);
+    REQUIRE(first->limits.maxLineLength == 100);
+    REQUIRE(first->layout.levels == 1);
+    REQUIRE(first->lang.at("c++").rules->size() == 1);
+    REQUIRE(!store.refresh());
+
+    // a new version is published, but the old one is untouched
+    rewrite(rulesfile, "#include <thread>@find_package(Threads REQUIRED)@Threads::Threads\n#include <regex>@@\n");
+    REQUIRE(store.refresh());
+    REQUIRE(store.version() == 2);
+    REQUIRE(first->lang.at("c++").rules->size() == 1);
+    auto snapshot{first};
+    store.update(snapshot);
+    REQUIRE(snapshot->version == 2);
+    REQUIRE(snapshot->lang.at("c++").rules->size() == 2);
+
+    // a bad configuration is reported once and the last good one is kept
+    rewrite(conffile, configuration("MaxLineLength=lots\n"));
+    REQUIRE_THROWS(store.refresh());
+    REQUIRE(!store.refresh());
+    REQUIRE(store.current() == snapshot);
+    rewrite(conffile, configuration("MaxLineLength=200\n"));
+    REQUIRE(store.refresh());
+    REQUIRE(store.version() == 3);
+    REQUIRE(store.current()->limits.maxLineLength == 200);
+
+    // so is a rules file that can't be read, rather than a language without rules
+    fs::remove(rulesfile);
+    REQUIRE_THROWS(store.refresh());
+    REQUIRE(store.version() == 3);
+    REQUIRE(store.current()->lang.at("c++").rules->size() == 2);
+    rewrite(rulesfile, "#include <thread>@find_package(Threads REQUIRED)@Threads::Threads\n");
+    REQUIRE(store.refresh());
+    REQUIRE(store.current()->lang.at("c++").rules->size() == 1);
+
+    // a project is extracted with the layout and languages of its snapshot
+    std::ofstream{dir / "hello.md"} << "# Hello\n### tags: ['c++']\n\n    #include <thread>\n    int main() {}\n";
+    AutoProject ap{dir / "hello.md", store.current()};
+    REQUIRE(ap.createProject(false));
+    const auto outdir{store.current()->layout.directory(dir / "hello.md")};
+    REQUIRE(outdir.parent_path().parent_path() == dir);
+    REQUIRE(fs::exists(outdir / "src" / "main.cpp"));
+    REQUIRE(ap.buildInfo().libraries == std::vector<std::string>{"Threads::Threads"});
+}
+
+#ifdef __linux__
+TEST_CASE("Watcher extracts .md files as they arrive", "[watcher]") {
+    const TempDir temp{"watcher"};
+    const fs::path& dir{temp.path()};
+    ConfigFile cfg{TEST_CONFIG_FILE};
+    WatchOptions options;
+    options.workers = 2;
+    options.debounce = 20ms;
+    std::stringstream log;
+    Watcher watcher{dir, std::make_shared<ConfigStore>(cfg), options, log};
+    std::thread runner{&Watcher::run, &watcher};
+    {
+        std::ofstream md{dir / "hello.md"};
+        md << "# [Hello](https://codereview.stackexchange.com/questions/1)\n"
+              "### tags: ['c++']\n\n"
+              "    #include <iostream>\n"
+              "    int main() { std::cout << \"Hello\\n\"; }\n";
+    }
+    // not a markdown file, so it must be ignored
+    std::ofstream{dir / "notes.txt"} << "    int x;\n";
+    const auto deadline{std::chrono::steady_clock::now() + 5s};
+    while (watcher.extracted() == 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(10ms);
+    }
+    watcher.stop();
+    runner.join();
+    REQUIRE(watcher.extracted() == 1);
+    REQUIRE(fs::exists(dir / "hello" / "src" / "main.cpp"));
+    REQUIRE(fs::exists(dir / "hello" / "CMakeLists.txt"));
+    REQUIRE(!fs::exists(dir / "notes"));
+}
+#endif
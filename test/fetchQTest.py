@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+""" Tests for bin/fetchQ against a local stand-in for the StackExchange API
+which serves the recorded questions in fetchq/questions.json.
+
+Usage: fetchQTest.py path/to/fetchQ """
+import copy
+import gzip
+import http.server
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import threading
+import unittest
+import urllib.parse
+
+FETCHQ = None
+RECORDED = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'fetchq', 'questions.json')
+
+
+class StandIn(http.server.ThreadingHTTPServer):
+    """ Answers /2.3/questions/<id;id;...>/ with the recorded items for
+    those IDs, gzipped as the real API does, and logs each request. """
+
+    def __init__(self):
+        super().__init__(('127.0.0.1', 0), Handler)
+        with open(RECORDED, encoding='utf-8') as f:
+            self.items = {item['question_id']: item for item in json.load(f)['items']}
+        self.requests = []
+
+    @property
+    def api(self):
+        return f'http://127.0.0.1:{self.server_address[1]}/2.3'
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    def do_GET(self):
+        url = urllib.parse.urlsplit(self.path)
+        query = urllib.parse.parse_qs(url.query)
+        ids = [int(q) for q in url.path.split('/')[3].split(';')]
+        apifilter = query['filter'][0]
+        self.server.requests.append((ids, apifilter))
+        items = []
+        for qnumber in ids[:int(query['pagesize'][0])]:
+            if qnumber in self.server.items:
+                item = copy.deepcopy(self.server.items[qnumber])
+                if apifilter == 'default':
+                    del item['body_markdown']
+                items.append(item)
+        body = gzip.compress(json.dumps({'items': items, 'has_more': False}).encode('utf-8'))
+        self.send_response(200)
+        self.send_header('Content-Type', 'application/json; charset=utf-8')
+        self.send_header('Content-Encoding', 'gzip')
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def log_message(self, format, *args):
+        pass
+
+
+class FetchQTest(unittest.TestCase):
+    def setUp(self):
+        self.server = StandIn()
+        threading.Thread(target=self.server.serve_forever, daemon=True).start()
+        self.tmp = tempfile.TemporaryDirectory()
+        self.dir = self.tmp.name
+        # records each invocation of autoproject
+        self.log = os.path.join(self.dir, 'autoproject.log')
+        self.stub = os.path.join(self.dir, 'autoproject')
+        with open(self.stub, 'w') as f:
+            f.write(f'#!/bin/sh\necho "$@" >> "{self.log}"\n')
+        os.chmod(self.stub, 0o755)
+
+    def tearDown(self):
+        self.server.shutdown()
+        self.server.server_close()
+        self.tmp.cleanup()
+
+    def fetchQ(self, *args):
+        return subprocess.run([sys.executable, FETCHQ, '--api', self.server.api, '--dir', self.dir,
+                               '--cache', os.path.join(self.dir, 'cache'), '--autoproject', self.stub]
+                              + list(args), capture_output=True, text=True)
+
+    def invocations(self):
+        with open(self.log) as f:
+            return [line.split() for line in f]
+
+    def test_batches_cache_and_refetch(self):
+        known = [206499, 93775, 248232]
+        # 101 IDs take two requests; the unknown ones are reported
+        idsfile = os.path.join(self.dir, 'ids.txt')
+        with open(idsfile, 'w') as f:
+            f.write('\n'.join(str(q) for q in known + list(range(1, 99))))
+        result = self.fetchQ('--ids', idsfile)
+        self.assertEqual(result.returncode, 1, result.stderr)
+        self.assertIn('Fetched 3 and reused 0 of 101 questions', result.stdout)
+        self.assertIn('question 98 not found', result.stderr)
+        self.assertEqual([(len(ids), f) for ids, f in self.server.requests],
+                         [(100, 'default'), (1, 'default'), (3, '!)5IYc5cM9scVj-ftqnOnMD(3TmXe')])
+        mdfiles = [os.path.join(self.dir, f'{q}.md') for q in known]
+        self.assertEqual(self.invocations(), [mdfiles])
+        with open(mdfiles[1], encoding='utf-8') as f:
+            first = f.read()
+
+        # nothing has changed, so only the activity dates are fetched
+        self.server.requests.clear()
+        result = self.fetchQ(*(str(q) for q in known))
+        self.assertEqual(result.returncode, 0, result.stderr)
+        self.assertIn('Fetched 0 and reused 3 of 3 questions', result.stdout)
+        self.assertEqual(self.server.requests, [(known, 'default')])
+        with open(mdfiles[1], encoding='utf-8') as f:
+            self.assertEqual(f.read(), first)
+
+        # only the question with new activity is fetched again
+        self.server.items[93775]['last_activity_date'] += 1
+        self.server.items[93775]['body_markdown'] += 'An edit.\r\n'
+        self.server.requests.clear()
+        result = self.fetchQ(*(str(q) for q in known))
+        self.assertIn('Fetched 1 and reused 2 of 3 questions', result.stdout)
+        self.assertEqual(self.server.requests[1:], [([93775], '!)5IYc5cM9scVj-ftqnOnMD(3TmXe')])
+        with open(mdfiles[1], encoding='utf-8') as f:
+            self.assertTrue(f.read().endswith('An edit.\n'))
+        self.assertEqual(len(self.invocations()), 3)
+
+    def test_single_question_to_named_file(self):
+        hello = os.path.join(self.dir, 'hello.md')
+        result = self.fetchQ('248232', hello, '--no-cache', '--no-extract')
+        self.assertEqual(result.returncode, 0, result.stderr)
+        self.assertEqual(self.server.requests, [([248232], '!)5IYc5cM9scVj-ftqnOnMD(3TmXe')])
+        self.assertFalse(os.path.exists(os.path.join(self.dir, 'cache')))
+        self.assertFalse(os.path.exists(self.log))
+        with open(hello, encoding='utf-8') as f:
+            text = f.read()
+        self.assertEqual(text, '# [Hello "world" in C](https://codereview.stackexchange.com/questions/248232)\n'
+                         "### tags: ['c']\n\n"
+                         '    #include <stdio.h>\n    int main(void) { puts("hi"); return 0; }\n')
+
+    def test_bad_question_number(self):
+        result = self.fetchQ('12x')
+        self.assertEqual(result.returncode, 2)
+        self.assertEqual(self.server.requests, [])
+
+
+if __name__ == '__main__':
+    FETCHQ = sys.argv.pop(1)
+    unittest.main()
@@ -0,0 +1,17 @@
+/*
+ * Parses the input as a configuration file and writes it back out.
+ */
+#include "ConfigFile.h"
+#include "FuzzTiming.h"
+#include <cstdint>
+#include <sstream>
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data, std::size_t size) {
+    fuzz::requireLinearTime({reinterpret_cast<const char *>(data), size}, [](std::string_view input) {
+        std::istringstream in{std::string{input}};
+        ConfigFile cfg{in};
+        std::ostringstream out;
+        out << cfg;
+    });
+    return 0;
+}
@@ -0,0 +1,34 @@
+/*
+ * Extracts a project from the input as if it were a downloaded .md file,
+ * keeping the output in memory.  This covers the scanner, the tag and
+ * file name parsing (including `trimExtras`) and the shipped rules.
+ */
+#include "AutoProject.h"
+#include "FuzzTiming.h"
+#include <cstdint>
+
+static std::map<std::string, LangConfig>& languages() {
+    static auto lang{[]{
+        auto lang{builtinLanguageSettings()};
+        preloadLanguages(lang);
+        return lang;
+    }()};
+    return lang;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data, std::size_t size) {
+    auto& lang{languages()};
+    fuzz::requireLinearTime({reinterpret_cast<const char *>(data), size}, [&lang](std::string_view input) {
+        // the directory must not exist, or nothing would be extracted
+        AutoProject ap{"/nonexistent/autoproject-fuzz/fuzz.md", std::string{input}, lang};
+        OutputBatch batch;
+        try {
+            ap.createProject(false, batch);
+            ap.buildInfo();
+        }
+        catch (const std::runtime_error&) {
+            // e.g. no template for an unknown language
+        }
+    });
+    return 0;
+}
@@ -0,0 +1,51 @@
+/*
+ * Runs a fuzz target over saved inputs, as libFuzzer does when given
+ * files rather than a corpus to grow, so that the regression corpus can
+ * be checked by ctest with any compiler.  Each argument is either an
+ * input file or a directory whose files are all inputs.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data, std::size_t size);
+
+int main(int argc, char *argv[]) {
+    std::vector<fs::path> inputs;
+    for (int i{1}; i < argc; ++i) {
+        if (fs::is_directory(argv[i])) {
+            for (const auto& entry : fs::recursive_directory_iterator(argv[i])) {
+                if (entry.is_regular_file()) {
+                    inputs.push_back(entry.path());
+                }
+            }
+        } else {
+            inputs.emplace_back(argv[i]);
+        }
+    }
+    std::sort(inputs.begin(), inputs.end());
+    if (inputs.empty()) {
+        std::fprintf(stderr, "Error: no inputs\n");
+        return 1;
+    }
+    for (const auto& input : inputs) {
+        std::ifstream in{input, std::ios::binary};
+        if (!in) {
+            std::fprintf(stderr, "Error: cannot read %s\n", input.c_str());
+            return 1;
+        }
+        const std::string data{std::istreambuf_iterator<char>{in}, {}};
+        std::printf("Running %s\n", input.c_str());
+        std::fflush(stdout);
+        LLVMFuzzerTestOneInput(reinterpret_cast<const std::uint8_t *>(data.data()), data.size());
+    }
+    std::printf("Ran %zu inputs\n", inputs.size());
+    return 0;
+}
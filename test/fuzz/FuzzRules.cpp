@@ -0,0 +1,43 @@
+/*
+ * Splits and compiles the input as a rules file, as `loadrules` does, 
+ * and applies every rule to a few typical lines of code, tokenized as
+ * in an extraction.  The lines are fixed so that the time taken grows
+ * only with the number of rules and the cost of each.
+ */
+#include "Rule.h"
+#include "FuzzTiming.h"
+#include <cstdint>
+#include <iostream>
+#include <regex>
+#include <vector>
+
+static const std::string sampleLines[]{
+    "#include <iostream>",
+    "int main() {",
+    "    std::vector<std::string> words{\"alpha\", \"beta\", \"gamma\"};",
+    "    std::thread worker{[&]{ std::cout << words.size() << '\\n'; }};",
+    "    if (SDL_Init(SDL_INIT_VIDEO) != 0) { return EXIT_FAILURE; }",
+    "        mov eax, [ebp + 8]    ; first argument",
+    "    return std::accumulate(v.begin(), v.end(), 0.0) / static_cast<double>(v.size());",
+};
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data, std::size_t size) {
+    // compileRules reports on std::cout and std::cerr
+    static const bool quiet{[]{
+        std::cout.rdbuf(nullptr);
+        std::cerr.rdbuf(nullptr);
+        return true;
+    }()};
+    (void)quiet;
+    fuzz::requireLinearTime({reinterpret_cast<const char *>(data), size}, [](std::string_view input) {
+        std::vector<RuleFields> fields;
+        forEachRule(input, [&fields](const RuleFields& f){ fields.push_back(f); });
+        for (const auto& rule : compileRules(fields, "fuzz input")) {
+            SourceTokenizer tokenizer;
+            for (const auto& line : sampleLines) {
+                rule.matches(tokenizer.next(line));
+            }
+        }
+    });
+    return 0;
+}
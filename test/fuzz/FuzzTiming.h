@@ -0,0 +1,83 @@
+#ifndef FUZZTIMING_H
+#define FUZZTIMING_H
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+/*
+ * Besides crashing, a fuzz target fails by taking more than linear time
+ * in the size of its input.  Each input is timed on its own against a
+ * budget proportional to its size, which catches exponential 
+ * backtracking, and then repeated several times over, which should take
+ * only proportionally longer.  Failures abort, so that libFuzzer saves
+ * the input and can minimize it with -minimize_crash=1.
+ */
+namespace fuzz {
+using Duration = std::chrono::steady_clock::duration;
+
+// generous, so that unoptimized builds on a busy machine still pass
+inline constexpr std::chrono::milliseconds baseBudget{250};
+inline constexpr std::chrono::microseconds byteBudget{50};
+// the input is repeated this many times for the growth check
+inline constexpr std::size_t repeats{8};
+// and may then take this many times `repeats` as long
+inline constexpr std::size_t slack{3};
+// times shorter than this are too noisy to compare
+inline constexpr std::chrono::milliseconds noiseFloor{20};
+
+template <typename Process>
+Duration timeOf(Process& process, std::string_view input, int runs = 1) {
+    auto best{Duration::max()};
+    for (int i{0}; i < runs; ++i) {
+        const auto start{std::chrono::steady_clock::now()};
+        process(input);
+        best = std::min(best, std::chrono::steady_clock::now() - start);
+    }
+    return best;
+}
+
+inline long long micros(Duration d) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+[[noreturn]] inline void fail(const char *what, std::size_t size, Duration taken, Duration allowed) {
+    std::fprintf(stderr, "==fuzz== %s: %zu bytes took %lld us, allowed %lld us\n",
+            what, size, micros(taken), micros(allowed));
+    std::abort();
+}
+
+/// run `process` on `input` and abort if its time grows faster than linearly
+template <typename Process>
+void requireLinearTime(std::string_view input, Process process) {
+    const auto budget{std::chrono::duration_cast<Duration>(baseBudget + byteBudget * input.size())};
+    auto once{timeOf(process, input)};
+    // anything slow is measured again before being reported
+    if (once > budget && (once = timeOf(process, input, 2)) > budget) {
+        fail("over budget", input.size(), once, budget);
+    }
+    if (input.empty()) {
+        return;
+    }
+    std::string repeated;
+    for (std::size_t i{0}; i < repeats; ++i) {
+        repeated.append(input);
+        // so that lines are repeated rather than made longer
+        if (!input.ends_with('\n')) {
+            repeated.push_back('\n');
+        }
+    }
+    auto allowed = [&]{ return std::max<Duration>(once * repeats * slack, noiseFloor); };
+    auto longer{timeOf(process, repeated)};
+    if (longer > allowed()) {
+        once = timeOf(process, input, 3);
+        longer = timeOf(process, repeated, 3);
+        if (longer > allowed()) {
+            fail("super-linear growth", repeated.size(), longer, allowed());
+        }
+    }
+}
+}
+#endif // FUZZTIMING_H